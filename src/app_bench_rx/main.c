@@ -0,0 +1,281 @@
+// --------------------------------------------
+// Radio throughput benchmark, receiver side. Pair with app_bench_tx.
+//
+// Counts the pings of each burst with the monitor receive path and
+// prints one Bench: line per burst to the serial port: achieved rates,
+// where the pings were lost, and the share of the time in the radio
+// receive handler on both sides.
+// --------------------------------------------
+
+#include "stdmansos.h"
+#include "../phaser_msg.h"
+#include "../db_framework.h"
+
+// Occupancy timing: Timer B from SMCLK / 8, 2 us at 4 MHz. The 32768 Hz
+// Timer A of the default trace clock ticks every 30 us, about as long as
+// a short timed call. Timer B is the MansOS sleep timer with USE_SLEEP,
+// not in the config. It wraps in 131 ms, longer than any timed call.
+#define TRACE_TIMER     TBR
+#define TRACE_TICK_HZ   (CPU_HZ / 8)
+#include "../app_phaser/trace.h"
+
+
+#define RATE_DELAY 200
+
+// Report a burst whose DONE was lost, after this long without its pings
+#define BENCH_IDLE_MS   1000
+
+// Define a buffer for receiving messages
+MSG_DEFINE_BUFFER_WITH_ID(radioBuffer, recv_data_p, RADIO_MAX_PACKET);
+
+
+// -------------------------------------------------------------------------
+// Burst statistics
+// -------------------------------------------------------------------------
+typedef struct {
+    uint16_t burst;         // 0: none yet
+    uint8_t sizeIdx;
+    uint8_t gapMs;
+    uint16_t count;         // Pings sent, from START or DONE
+    uint16_t recvPktCount;  // Pings received and valid
+    uint16_t recvPktDropped;    // "RX Locked": receiving while processing another packet
+    uint16_t recvPktFailed; // radioRecv failed, length <0
+    uint16_t recvPktInvalid;    // Signature or checksum failed
+    uint16_t recvPktDup;    // Ping seq not above the last one
+    uint16_t lastSeq;
+    uint32_t firstMs;       // Time of the first and the last ping
+    uint32_t lastMs;
+    uint32_t startMs;       // START, or the first message of the burst
+    uint32_t isrTicks;      // In onRadioRecv()
+    bool flDone;            // DONE received, TX counters below
+    bool flReported;
+    phaser_bench_t tx;
+} bench_stat_t;
+
+bench_stat_t stat;
+
+static uint32_t lastRxTime = 0;
+
+
+// =========================================================================
+// =========================================================================
+
+// -------------------------------------------------------------------------
+// Free running Timer B from SMCLK / 8 for trace_ticks()
+// -------------------------------------------------------------------------
+void bench_timer_init()
+{
+    TBCTL = TBSSEL_2 | ID_3 | MC_2 | TBCLR;
+}
+
+// -------------------------------------------------------------------------
+// Share of the time, per mille
+// -------------------------------------------------------------------------
+static int bench_permille(uint32_t ticks, uint32_t ms, uint32_t tickHz)
+{
+    uint32_t total = ms * (tickHz / 8) / 125;
+    if( total == 0 ) return 0;
+    return (int) (ticks * 1000 / total);
+}
+
+// -------------------------------------------------------------------------
+// Packets per second
+// -------------------------------------------------------------------------
+static int bench_rate(uint16_t count, uint32_t ms)
+{
+    if( ms == 0 ) return 0;
+    return (int) ((uint32_t)count * 1000 / ms);
+}
+
+// -------------------------------------------------------------------------
+// Print the burst. The TX columns are -1 when its DONE was lost.
+// txBusy: the sender in the radio send and the TX busy wait, the TX path
+// runs from its main loop. rxIsr: the receiver in onRadioRecv().
+// -------------------------------------------------------------------------
+void bench_report()
+{
+    int lost;
+    int txFail = -1, txPps = -1, txBusy = -1;
+    long txTickHz = -1;
+
+    if( stat.burst == 0 || stat.flReported ) return;
+    stat.flReported = true;
+
+    if( stat.flDone ){
+        txFail = stat.tx.txFail;
+        txPps = bench_rate(stat.count, stat.tx.txMs);
+        txBusy = bench_permille(stat.tx.txBusyTicks, stat.tx.txMs, stat.tx.tickHz);
+        txTickHz = stat.tx.tickHz;
+    }
+    // Not accounted for by the counters: lost in the air or in the radio
+    lost = (int)stat.count - (txFail > 0 ? txFail : 0) - stat.recvPktCount -
+        stat.recvPktDropped - stat.recvPktFailed - stat.recvPktInvalid;
+
+    PRINTF("Bench:\t%u\t%d\t%d\t%u\t%d\t%d\t%d\t%u\t%d\t%u\t%u\t%u\t%u\t%d\t%d\t%ld\t%lu\n",
+        (unsigned) stat.burst,
+        (int) PH_BENCH_SIZE_BYTES(stat.sizeIdx),
+        (int) stat.gapMs,
+        (unsigned) stat.count,
+        txFail, txPps, txBusy,
+        (unsigned) stat.recvPktCount,
+        bench_rate(stat.recvPktCount, stat.lastMs - stat.firstMs),
+        (unsigned) stat.recvPktDropped,
+        (unsigned) stat.recvPktFailed,
+        (unsigned) stat.recvPktInvalid,
+        (unsigned) stat.recvPktDup,
+        lost,
+        bench_permille(stat.isrTicks, stat.lastMs - stat.startMs, TRACE_TICK_HZ),
+        txTickHz, (unsigned long) TRACE_TICK_HZ);
+}
+
+// -------------------------------------------------------------------------
+// First message of a burst: report the previous one, clear the counters
+// -------------------------------------------------------------------------
+void bench_burst_start(uint16_t burst, uint8_t sizeIdx, uint8_t gapMs)
+{
+    bench_report();
+    memset(&stat, 0, sizeof(stat));
+    stat.burst = burst;
+    stat.sizeIdx = sizeIdx;
+    stat.gapMs = gapMs;
+    stat.startMs = getTimeMs();
+    stat.lastMs = stat.startMs;
+}
+
+// -------------------------------------------------------------------------
+// The ping checksum, by its size
+// -------------------------------------------------------------------------
+bool bench_ping_ok(uint8_t sizeIdx)
+{
+    bool flOK = true;
+
+    switch( sizeIdx ){
+    case PH_BENCH_SIZE_8:
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_bench_ping8_t, flOK=false );
+        break;
+    case PH_BENCH_SIZE_32:
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_bench_ping32_t, flOK=false );
+        break;
+    case PH_BENCH_SIZE_64:
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_bench_ping64_t, flOK=false );
+        break;
+    case PH_BENCH_SIZE_100:
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_bench_ping100_t, flOK=false );
+        break;
+    default:
+        flOK = false;
+    }
+    return flOK;
+}
+
+// --------------------------------------------
+// Same receive path as app_monitor, with the counters
+// --------------------------------------------
+void bench_recv(void)
+{
+    bool flOK = true;
+    int16_t rxLen;
+
+    led1Toggle();
+
+    rxLen = radioRecv(&radioBuffer, sizeof(radioBuffer));
+    if (rxLen < 0) {
+        led2Toggle();
+        stat.recvPktFailed++;
+        return;
+    }
+
+    if( ! MSG_SIGNATURE_OK(radioBuffer) ) {
+        stat.recvPktInvalid++;
+        return;
+    }
+    lastRxTime = getTimeMs();
+
+    // Anticipated payload types.
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_bench_t, bench_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_bench_hdr_t, ping_p);
+
+    switch( radioBuffer.id ){
+    case PH_MSG_BenchPing:
+        if( !bench_ping_ok(ping_p->sizeIdx) ){
+            stat.recvPktInvalid++;
+            break;
+        }
+        // START lost
+        if( ping_p->burst != stat.burst ){
+            bench_burst_start(ping_p->burst, ping_p->sizeIdx, ping_p->gapMs);
+        }
+        if( stat.recvPktCount > 0 && ping_p->seq <= stat.lastSeq ){
+            stat.recvPktDup++;
+            break;
+        }
+        if( stat.recvPktCount == 0 ) stat.firstMs = lastRxTime;
+        stat.lastMs = lastRxTime;
+        stat.lastSeq = ping_p->seq;
+        stat.recvPktCount++;
+        break;
+
+    case PH_MSG_Bench:
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_bench_t, flOK=false );
+        if( !flOK ){
+            stat.recvPktInvalid++;
+            break;
+        }
+        if( bench_p->burst != stat.burst ){
+            bench_burst_start(bench_p->burst, bench_p->sizeIdx, bench_p->gapMs);
+        }
+        stat.count = bench_p->count;
+        if( bench_p->action == MSG_ACT_DONE && !stat.flDone ){
+            stat.flDone = true;
+            memcpy(&stat.tx, bench_p, sizeof(phaser_bench_t));
+            if( stat.recvPktCount == 0 ) stat.lastMs = lastRxTime;
+        }
+        break;
+    }
+}
+
+// --------------------------------------------
+// --------------------------------------------
+void onRadioRecv(void)
+{
+    static bool flRxProcessing=false;
+    uint16_t tick0;
+
+    if(flRxProcessing){
+        stat.recvPktDropped++;
+        return;
+    }
+    flRxProcessing=true;    // There is a chance for a small race condition
+
+    tick0 = trace_ticks();
+    bench_recv();
+    stat.isrTicks += (uint16_t)(trace_ticks() - tick0);
+
+    flRxProcessing=false;
+}
+
+// --------------------------------------------
+// --------------------------------------------
+void appMain(void)
+{
+    bench_timer_init();
+    radioSetReceiveHandle(onRadioRecv);
+    radioOn();
+
+    // Pps: packets per second. Pm: per mille of the burst time.
+    // TickHz: the rate of the occupancy timer, each timed call is
+    // +-1 tick of it.
+    PRINTF("BenchHdr:\tburst\tbytes\tgapMs\tcount\ttxFail\ttxPps\ttxBusyPm"
+        "\trxOk\trxPps\trxLocked\trxFailed\trxInvalid\trxDup\tlost\trxIsrPm"
+        "\ttxTickHz\trxTickHz\n");
+
+    while (1) {
+        mdelay(RATE_DELAY);
+
+        // The DONE repeats are over, or all of them were lost
+        if( stat.flDone || (stat.burst && getTimeMs() - lastRxTime > BENCH_IDLE_MS) ){
+            bench_report();
+        }
+        led0Toggle();
+    }
+}
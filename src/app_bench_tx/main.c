@@ -0,0 +1,183 @@
+// --------------------------------------------
+// Radio throughput benchmark, sender side. Pair with app_bench_rx.
+//
+// Sends bursts of BENCH_COUNT fixed length pings, the phaser test loop
+// without the antenna, for each ping size and gap of the plan below,
+// and reports its side of each burst to the receiver. The plan repeats
+// until power off.
+// --------------------------------------------
+
+#include "stdmansos.h"
+#include "cc2420/cc2420.h"
+
+#include "../phaser_msg.h"
+#include "../msg_framework.h"
+
+// Occupancy timing: Timer B from SMCLK / 8, 2 us at 4 MHz. The 32768 Hz
+// Timer A of the default trace clock ticks every 30 us, about as long as
+// a short timed call. Timer B is the MansOS sleep timer with USE_SLEEP,
+// not in the config. It wraps in 131 ms, longer than any timed call.
+#define TRACE_TIMER     TBR
+#define TRACE_TICK_HZ   (CPU_HZ / 8)
+#include "../app_phaser/trace.h"
+
+// Comment below for no serial output
+#define DEBUG_BENCH 1
+
+
+#define BENCH_COUNT         200     // Pings in a burst
+#define BENCH_START_DELAY   2000    // After boot, for the receiver to start
+#define BENCH_PAUSE_MS      300     // Between the bursts, receiver prints
+#define BENCH_CTRL_GAP_MS   5       // Between the START/DONE repeats
+
+// Gaps between the pings, ms. 0: back to back, as fast as the TX path goes.
+static const uint8_t benchGaps[] = { 0, 1, 2, 5, 10, 20 };
+#define BENCH_GAPS  (sizeof(benchGaps)/sizeof(benchGaps[0]))
+
+
+// -------------------------------------------------------------------------
+// Types and global data
+// -------------------------------------------------------------------------
+
+// Burst start and end
+MSG_NEW_WITH_ID(bench_msg, phaser_bench_t, PH_MSG_Bench);
+
+// One ping message per size
+MSG_NEW_WITH_ID(ping8_msg, phaser_bench_ping8_t, PH_MSG_BenchPing);
+MSG_NEW_WITH_ID(ping32_msg, phaser_bench_ping32_t, PH_MSG_BenchPing);
+MSG_NEW_WITH_ID(ping64_msg, phaser_bench_ping64_t, PH_MSG_BenchPing);
+MSG_NEW_WITH_ID(ping100_msg, phaser_bench_ping100_t, PH_MSG_BenchPing);
+
+static uint16_t burst = 0;
+
+
+// =========================================================================
+// =========================================================================
+
+// -------------------------------------------------------------------------
+// Free running Timer B from SMCLK / 8 for trace_ticks()
+// -------------------------------------------------------------------------
+void bench_timer_init()
+{
+    TBCTL = TBSSEL_2 | ID_3 | MC_2 | TBCLR;
+}
+
+// -------------------------------------------------------------------------
+// Delay in ms, using a variable instead of constant.
+// -------------------------------------------------------------------------
+void mdelay_var(int ms)
+{
+    uint16_t k;
+    for(k=ms; k>0; k--){
+        mdelay(1);
+    }
+}
+
+// -------------------------------------------------------------------------
+// START or DONE of the burst, repeated: not acknowledged
+// -------------------------------------------------------------------------
+void bench_ctrl_send(msg_action_t action)
+{
+    int i;
+
+    bench_msg.payload.action = action;
+    MSG_DO_CHECKSUM( bench_msg );
+    for(i=0; i<PH_BENCH_CTRL_REPEAT; i++){
+        MSG_RADIO_SEND( bench_msg );
+        while( cc2420IsTxBusy() );
+        mdelay(BENCH_CTRL_GAP_MS);
+    }
+}
+
+// -------------------------------------------------------------------------
+// Send one ping of the burst. Return the radio send result.
+// -------------------------------------------------------------------------
+#define BENCH_PING_SEND( msg, hdr, err )  do{  \
+    (msg).payload.h = *(hdr);  \
+    MSG_DO_CHECKSUM( msg );  \
+    err = MSG_RADIO_SEND( msg );  \
+}while(0)
+
+int bench_ping_send(const phaser_bench_hdr_t *hdr)
+{
+    int err = -1;
+
+    switch( hdr->sizeIdx ){
+    case PH_BENCH_SIZE_8: BENCH_PING_SEND( ping8_msg, hdr, err ); break;
+    case PH_BENCH_SIZE_32: BENCH_PING_SEND( ping32_msg, hdr, err ); break;
+    case PH_BENCH_SIZE_64: BENCH_PING_SEND( ping64_msg, hdr, err ); break;
+    case PH_BENCH_SIZE_100: BENCH_PING_SEND( ping100_msg, hdr, err ); break;
+    }
+    return err;
+}
+
+// -------------------------------------------------------------------------
+// Run one burst and report it
+// -------------------------------------------------------------------------
+void bench_burst(uint8_t sizeIdx, uint8_t gapMs)
+{
+    phaser_bench_hdr_t hdr;
+    uint32_t t0;
+    uint16_t tick0;
+    uint16_t txFail = 0;
+    uint32_t busy = 0;
+    int err;
+
+    burst++;
+    memset(&bench_msg.payload, 0, sizeof(phaser_bench_t));
+    bench_msg.payload.burst = burst;
+    bench_msg.payload.sizeIdx = sizeIdx;
+    bench_msg.payload.gapMs = gapMs;
+    bench_msg.payload.count = BENCH_COUNT;
+    bench_ctrl_send(MSG_ACT_START);
+
+    hdr.burst = burst;
+    hdr.sizeIdx = sizeIdx;
+    hdr.gapMs = gapMs;
+
+    t0 = getTimeMs();
+    for(hdr.seq=0; hdr.seq<BENCH_COUNT; hdr.seq++){
+        if( hdr.seq > 0 ) mdelay_var(gapMs);
+
+        tick0 = trace_ticks();
+        err = bench_ping_send(&hdr);
+        while( cc2420IsTxBusy() );
+        busy += (uint16_t)(trace_ticks() - tick0);
+
+        if( err < 0 ) txFail++;
+        led1Toggle();
+    }
+
+    bench_msg.payload.txFail = txFail;
+    bench_msg.payload.txMs = getTimeMs() - t0;
+    bench_msg.payload.txBusyTicks = busy;
+    bench_msg.payload.tickHz = TRACE_TICK_HZ;
+    bench_ctrl_send(MSG_ACT_DONE);
+
+#ifdef DEBUG_BENCH
+    PRINTF("Burst %u: %d bytes, gap %d ms, %u ms, %u failed\n",
+        (unsigned) burst, (int) PH_BENCH_SIZE_BYTES(sizeIdx), (int) gapMs,
+        (unsigned) bench_msg.payload.txMs, (unsigned) txFail);
+#endif
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+void appMain(void)
+{
+    uint8_t sizeIdx, g;
+
+    bench_timer_init();
+    radioOn();
+    mdelay(BENCH_START_DELAY);
+
+    while (1) {
+        for(sizeIdx=0; sizeIdx<PH_BENCH_SIZES; sizeIdx++){
+            for(g=0; g<BENCH_GAPS; g++){
+                bench_burst(sizeIdx, benchGaps[g]);
+                mdelay(BENCH_PAUSE_MS);
+            }
+        }
+        led0Toggle();
+    }
+}
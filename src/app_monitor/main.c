@@ -9,10 +9,16 @@
 #include "stdmansos.h"
 #include "../phaser_msg.h"
 #include "../db_framework.h"
+#include "../app_phaser/schedule.h"
+#include "ping_rebuild.h"
 
 // Comment below for less output
 // #define PRINT_PACKETS 1
 
+// Uncomment to send the TDMA beacon, for several phaser nodes.
+// See PH_TDMA_* in phaser_msg.h.
+// #define TDMA_BEACON 1
+
 
 #define RATE_DELAY 200
 
@@ -20,6 +26,30 @@
 MSG_NEW_WITH_ID(ctrl_msg, phaser_control_t, PH_MSG_Control);
 phaser_control_t *ctrl_data_p = &(ctrl_msg.payload);
 
+// Config for the running test, sent on the serial command
+MSG_NEW_WITH_ID(config_msg, test_config_t, PH_MSG_Config);
+
+// ACK of the sequenced control and session messages
+MSG_NEW_WITH_ID(ack_msg, phaser_control_t, PH_MSG_Control);
+
+// Experiment converged message (adaptive mode)
+MSG_NEW_WITH_ID(converged_msg, phaser_converged_t, PH_MSG_Converged);
+
+// Experiment result reply (beam search)
+MSG_NEW_WITH_ID(result_msg, phaser_result_t, PH_MSG_Result);
+
+// Reverse link: reply to the test message
+MSG_NEW_WITH_ID(echo_msg, phaser_echo_t, PH_MSG_Echo);
+
+// Shard assignment of the rig, sent on the serial command
+MSG_NEW_WITH_ID(shard_msg, phaser_shard_t, PH_MSG_Shard);
+
+// TLV config chunk, sent on the serial command
+MSG_NEW_WITH_ID(tlv_msg, phaser_tlv_chunk_t, PH_MSG_ConfigTlv);
+
+// Timing trace dump request, sent on the serial command
+MSG_NEW_WITH_ID(trace_msg, phaser_trace_t, PH_MSG_Trace);
+
 // Define a buffer for receiving messages
 MSG_DEFINE_BUFFER_WITH_ID(radioBuffer, recv_data_p, RADIO_MAX_PACKET);
 
@@ -47,6 +77,20 @@ test_config_t test_config = {
     },
 };
 
+// TLV config, applied on top of the running one, sent on the serial command.
+// Power innermost, then the second antenna dimension, the channel list
+// and the dwell: 20, 40 and 60 pings per step.
+static const uint8_t tlvConfig[] = {
+    TLV_SWEEP_MODE, 1, SWEEP_MODE_FULL,
+    TLV_SEND_DELAY, 2, TLV_U16(20),
+    TLV_ANT_B, 4, 0, 32, TLV_U16(8),
+    TLV_DIM_LIST, 5, SWEEP_DIM_POWER, TLV_U16(31), TLV_U16(15),
+    TLV_DIM_RANGE, 7, SWEEP_DIM_ANT_B, TLV_U16(0), TLV_U16(1), TLV_U16(8),
+    TLV_DIM_LIST, 7, SWEEP_DIM_CHANNEL, TLV_U16(15), TLV_U16(20), TLV_U16(25),
+    TLV_DIM_RANGE, 7, SWEEP_DIM_DWELL, TLV_U16(20), TLV_U16(20), TLV_U16(3),
+};
+#define TLV_CHUNK_DELAY_MS  5
+
 
 
 
@@ -54,20 +98,70 @@ test_config_t test_config = {
 //===========================================
 //  Experimental data
 //===========================================
-#define NUM_EXPS 128
+// One record by phaser node
+#define NUM_EXPS PH_NODE_MAX
 
 static experiment_t experiment[NUM_EXPS];
-experiment_t * curExp = NULL;
-
-int lastExpIdx=0;
+experiment_t * curExp[PH_NODE_MAX];
+int lastExpIdx[PH_NODE_MAX];
 
 int rxIdx=0;
 
 static bool flRestart=true;
 
+// Received configs by config_idx, for the adaptive mode parameters
+#define CONFIG_STORE_MAX 16
+static test_config_t configStore[CONFIG_STORE_MAX];
+
+// config_idx of the config received since the last ConfigAck, -1: none
+static int8_t configRecvIdx = -1;
+
+// Converged message already sent for the current experiment
+static bool flConverged[PH_NODE_MAX];
+
+// Continuous wave sweep: announced by the phaser, sampled by appMain()
+#define CW_DETECT_DB        10      // Carrier onset: RSSI over the noise
+#define CW_DETECT_TIMEOUT_MS 500
+#define CW_POLL_MS          10      // appMain() check for the sweep
+
+typedef struct
+{
+    int32_t sum;
+    uint16_t num;
+} cw_bin_t;
+
+static phaser_cw_t cwSweep;
+static volatile bool fl_cwArmed = false;
+static volatile bool fl_cwAbort = false;
+static cw_bin_t cwBins[CW_SLOT_MAX];
+
+// Radio channel, set by the phaser. Back to the home one when idle.
+static uint8_t radioChannel = PH_CHANNEL_HOME;
+static volatile uint32_t lastRxTime = 0;
+
+// Compact pings: the sweep position of each node, see ping_rebuild.h
+static ping_anchor_t anchor[PH_NODE_MAX];
+
+// Last sequenced control message received by node, for dropping the
+// retransmissions
+static uint8_t lastRxSeq[PH_NODE_MAX];
+static uint32_t lastRxSeqTime[PH_NODE_MAX];
+
+#ifdef TDMA_BEACON
+// TDMA beacon, and the state of the nodes it reports
+MSG_NEW_WITH_ID(beacon_msg, phaser_beacon_t, PH_MSG_Beacon);
+static uint32_t nextBeaconTime = 0;
+static uint32_t nodeHeardTime[PH_NODE_MAX];
+static uint8_t nodeHeardMask = 0;
+static volatile uint8_t nodeReadyMask = 0;
+static volatile angle_t tdmaAngle = ANGLE_NOT_SET_VALUE;
+#endif
+
 
 // Prototypes
 void send_ctrl_msg(msg_action_t act);
+void configStoreInvalidate(uint8_t idx);
+void send_tlv_config(const uint8_t *buf, uint16_t len);
 
 
 // --------------------------------------------
@@ -91,6 +185,42 @@ void onSerRecv(uint8_t bytes)
         flRestart = true;
         send_ctrl_msg(MSG_ACT_RESTART);
     }
+    if(bytes>=1 && serBuffer[0] == 'c'){
+        PRINTF("Ser: Resume!\n");
+        send_ctrl_msg(PH_ACT_RESUME);
+    }
+    if(bytes>=1 && serBuffer[0] == 'g'){
+        PRINTF("Ser: Config!\n");
+        MSG_COPY_AND_SEND(config_msg, &test_config);
+    }
+    // "h<idx><count>[s]": run shard idx of count, 's' for the stride mode.
+    // "h" alone: the whole campaign.
+    if(bytes>=1 && serBuffer[0] == 'h'){
+        PRINTF("Ser: Shard!\n");
+        shard_msg.payload.action = MSG_ACT_SET;
+        shard_msg.payload.shardIdx = 0;
+        shard_msg.payload.shardCount = 0;
+        shard_msg.payload.mode = SHARD_MODE_RANGE;
+        if( bytes >= 3 ){
+            shard_msg.payload.shardIdx = serBuffer[1] - '0';
+            shard_msg.payload.shardCount = serBuffer[2] - '0';
+        }
+        if( bytes >= 4 && serBuffer[3] == 's' ) shard_msg.payload.mode = SHARD_MODE_STRIDE;
+        MSG_DO_CHECKSUM( shard_msg );
+        MSG_RADIO_SEND( shard_msg );
+    }
+    if(bytes>=1 && serBuffer[0] == 'l'){
+        PRINTF("Ser: TLV config!\n");
+        send_tlv_config(tlvConfig, sizeof(tlvConfig));
+    }
+    // "y<node>": timing trace dump of the phaser node, "y" alone: all nodes
+    if(bytes>=1 && serBuffer[0] == 'y'){
+        PRINTF("Ser: Trace!\n");
+        trace_msg.payload.action = MSG_ACT_STATUS;
+        trace_msg.payload.nodeId = (bytes >= 2) ? serBuffer[1] - '0' : PH_NODE_ALL;
+        MSG_DO_CHECKSUM( trace_msg );
+        MSG_RADIO_SEND( trace_msg );
+    }
 
 }
 
@@ -100,20 +230,109 @@ void onSerRecv(uint8_t bytes)
 void send_ctrl_msg(msg_action_t act)
 {
     ctrl_msg.payload.action = act;
+    ctrl_msg.payload.seq = 0;
     MSG_DO_CHECKSUM( ctrl_msg );
     MSG_RADIO_SEND( ctrl_msg );
 }
 
+// --------------------------------------------
+// The stored config is not the one the phaser runs: not used until the
+// phaser sends it. The compact pings of it are not rebuilt meanwhile.
+// --------------------------------------------
+void configStoreInvalidate(uint8_t idx)
+{
+    uint8_t node;
+
+    memset(&(configStore[idx]), 0, sizeof(test_config_t));
+    for(node=0; node<PH_NODE_MAX; node++){
+        if( anchor[node].a.configIdx == idx ) anchor[node].valid = false;
+    }
+}
+
+// --------------------------------------------
+// TLV config in chunks. Not acknowledged one by one: the phaser replies
+// with PH_MSG_ConfigAck when it has the whole config, or INCOMPLETE when
+// chunks are missing after TLV_RX_TIMEOUT_MS. Send it again then.
+// --------------------------------------------
+void send_tlv_config(const uint8_t *buf, uint16_t len)
+{
+    static uint8_t xfer = 0;
+    uint8_t i, count;
+
+    if( len > PH_TLV_MAX ) return;
+    count = (len + PH_TLV_CHUNK - 1) / PH_TLV_CHUNK;
+
+    tlv_msg.payload.xfer = ++xfer;
+    tlv_msg.payload.count = count;
+    for(i=0; i<count; i++){
+        tlv_msg.payload.idx = i;
+        tlv_msg.payload.len = (i+1 < count) ? PH_TLV_CHUNK : len - i * PH_TLV_CHUNK;
+        memcpy(tlv_msg.payload.data, buf + i * PH_TLV_CHUNK, tlv_msg.payload.len);
+        MSG_DO_CHECKSUM( tlv_msg );
+        MSG_RADIO_SEND( tlv_msg );
+        mdelay(TLV_CHUNK_DELAY_MS);
+    }
+}
+
+// --------------------------------------------
+// Reliable control: ACK the sequenced message.
+// Return false if it is a retransmission of the last one.
+// --------------------------------------------
+bool ctrl_rx_seq(uint8_t seq)
+{
+    uint32_t now = getTimeMs();
+    uint8_t node = PH_CTRL_SEQ_NODE(seq);
+
+    if( seq == 0 ) return true;     // Not sequenced
+
+    ack_msg.payload.action = MSG_ACT_ACK;
+    ack_msg.payload.seq = seq;
+    MSG_DO_CHECKSUM( ack_msg );
+    MSG_RADIO_SEND( ack_msg );
+
+    if( seq == lastRxSeq[node] && now - lastRxSeqTime[node] < PH_CTRL_DUP_WINDOW_MS ){
+        return false;
+    }
+    lastRxSeq[node] = seq;
+    lastRxSeqTime[node] = now;
+    return true;
+}
+
+// --------------------------------------------
+// Antenna state vector as text: the element states, ':' separated.
+// The buffer is reused by the next call.
+// --------------------------------------------
+const char *antStr(const ant_state_t *ant)
+{
+    static char buf[ANT_FORMAT_ELEMENTS_MAX * 4 + 1];     // "255:" each
+    uint8_t bits = ANT_FORMAT_BITS(ant->format);
+    uint8_t n = ANT_FORMAT_ELEMENTS(ant->format);
+    uint8_t i, v, d;
+    char *p = buf;
+
+    if( bits != 1 && bits != 2 && bits != 4 && bits != 8 ) return "?";
+    if( n * bits > ANT_STATE_BYTES * 8 ) return "?";
+
+    for(i=0; i<n; i++){
+        if( i ) *p++ = ':';
+        v = ANT_EL_GET(ant, i, bits);
+        for(d=100; d>1 && d>v; d/=10);
+        for( ; d; d/=10) *p++ = '0' + (v / d) % 10;
+    }
+    *p = 0;
+    return buf;
+}
+
 // --------------------------------------------
 // --------------------------------------------
 // void sendTestResults(int expIdxFrom, int expIdxTo)
-void sendTestResults()
+void sendTestResults(uint8_t node)
 {
     int rssi_mean, lqi_mean;
     int32_t rssi_devSq, lqi_devSq;
-    experiment_t *exp = curExp;
+    experiment_t *exp = curExp[node];
 
-    curExp = NULL;  // Avoid retransmission of the same experiment
+    curExp[node] = NULL;  // Avoid retransmission of the same experiment
 
     // int i;
     // for (i=expIdxFrom; i<=expIdxTo; i++)
@@ -124,18 +343,20 @@ void sendTestResults()
         lqi_mean = STREAM_STAT_MEAN(exp->lqi_data);
         lqi_devSq = STREAM_STAT_DEVIATION_SQUARED(exp->lqi_data);
         PRINTF("Test:"
-            "\t%d"
-            "\t%d\t%d\t%d"
+            "\t%d\t%d"
+            "\t%d\t%d\t%s"
             // "\t%d\t%d\t%d\t%d\t%ld"
             // "\t%d\t%d\t%d\t%d\t%ld"
             "\t%d\t%d\t%d"
             "\t%ld\t%ld"
+            "\t%d\t%d"
             "\n",
-            (int) lastExpIdx,
+            (int) lastExpIdx[node],
+            (int) exp->configIdx,
 
             (int) exp->power,
             (int) exp->angle,
-            (int) exp->phase,
+            antStr(&exp->ant),
 
             // (int) exp->rssi_data.sum,
             // (int) exp->rssi_data.sum_squares,
@@ -149,14 +370,19 @@ void sendTestResults()
             (int) lqi_mean,
 
             (long unsigned int) (rssi_devSq),
-            (long unsigned int) (lqi_devSq)
+            (long unsigned int) (lqi_devSq),
+            (int) exp->channel,
+            (int) node
             )
         // debugHexdump((uint8_t *) exp, sizeof(experiment_t));
 
         // Clear data
+        flConverged[node] = false;
+        exp->configIdx = 0;
         exp->power = 0;
         exp->angle = 0;
-        exp->phase = 0;
+        memset(&exp->ant, 0, sizeof(ant_state_t));
+        exp->channel = 0;
         STREAM_STAT_INIT(exp->rssi_data);
         STREAM_STAT_INIT(exp->lqi_data);
     }
@@ -164,6 +390,189 @@ void sendTestResults()
 
 }
 
+// --------------------------------------------
+// Output the experiments of all the nodes, before the other messages
+// --------------------------------------------
+void sendAllResults()
+{
+    uint8_t node;
+    for(node=0; node<PH_NODE_MAX; node++){
+        if( curExp[node] ) sendTestResults(node);
+    }
+}
+
+// --------------------------------------------
+// Adaptive mode: tell the phaser to move on, when the 95% confidence
+// interval of the RSSI mean is narrow enough: 2*sd/sqrt(n) < ci.
+// With ci in 1/4 dB: 64*var < ci^2 * n
+// --------------------------------------------
+void checkConvergence(phaser_ping_t * test, experiment_t *exp)
+{
+    test_config_t *cfg;
+    int32_t var;
+    int32_t n = exp->rssi_data.num;
+
+    if( flConverged[test->nodeId] || test->configIdx >= CONFIG_STORE_MAX ) return;
+    cfg = &(configStore[test->configIdx]);
+    if( cfg->send_count_min == 0 || n < cfg->send_count_min ) return;
+
+    var = STREAM_STAT_DEVIATION_SQUARED(exp->rssi_data);
+    if( 64 * var >= (int32_t)cfg->converge_ci * cfg->converge_ci * n ) return;
+
+    converged_msg.payload.expIdx = test->expIdx;
+    converged_msg.payload.nodeId = test->nodeId;
+    MSG_DO_CHECKSUM( converged_msg );
+    MSG_RADIO_SEND( converged_msg );
+    flConverged[test->nodeId] = true;
+}
+
+// --------------------------------------------
+// Beam search: reply with the RSSI mean of the experiment.
+// num=0 if the experiment is not the current one.
+// --------------------------------------------
+void sendResult(uint16_t expIdx, uint8_t node)
+{
+    experiment_t *exp = curExp[node];
+
+    result_msg.payload.expIdx = expIdx;
+    result_msg.payload.nodeId = node;
+    result_msg.payload.num = 0;
+    result_msg.payload.rssi = 0;
+    if( exp && lastExpIdx[node] == expIdx && exp->rssi_data.num > 0 ){
+        result_msg.payload.num = exp->rssi_data.num;
+        result_msg.payload.rssi = (exp->rssi_data.sum * 4) / exp->rssi_data.num;
+    }
+    result_msg.payload.action = MSG_ACT_ACK;
+    MSG_DO_CHECKSUM( result_msg );
+    MSG_RADIO_SEND( result_msg );
+}
+
+// --------------------------------------------
+// Reverse link: echo the test message, if its config asks for it
+// --------------------------------------------
+void sendEcho(phaser_ping_t * test)
+{
+    if( test->configIdx >= CONFIG_STORE_MAX ) return;
+    if( !configStore[test->configIdx].echo ) return;
+
+    echo_msg.payload.expIdx = test->expIdx;
+    echo_msg.payload.msgCounter = test->msgCounter;
+    echo_msg.payload.nodeId = test->nodeId;
+    MSG_DO_CHECKSUM( echo_msg );
+    MSG_RADIO_SEND( echo_msg );
+}
+
+// --------------------------------------------
+// TDMA: node activity and the stepper angle for the beacon
+// --------------------------------------------
+#ifdef TDMA_BEACON
+void tdma_heard(uint8_t node)
+{
+    nodeHeardTime[node] = getTimeMs();
+    nodeHeardMask |= 1 << node;
+}
+
+void tdma_angle(angle_t angle)
+{
+    if( angle == tdmaAngle ) return;
+    tdmaAngle = angle;
+    nodeReadyMask = 0;      // All the nodes are busy at the new angle
+}
+
+// --------------------------------------------
+// Send the beacon at the frame grid, every PH_TDMA_BEACON_MS.
+// Called at least every CW_POLL_MS.
+// --------------------------------------------
+void tdma_beacon_tick()
+{
+    uint32_t now = getTimeMs();
+    phaser_beacon_t *b = &(beacon_msg.payload);
+    uint8_t node, active = 0;
+
+    if( (int32_t)(nextBeaconTime - now) > CW_POLL_MS ) return;
+    if( (int32_t)(nextBeaconTime - now) < 0 ){
+        nextBeaconTime = now;       // Late, realign the grid
+    }
+    while( (int32_t)(getTimeMs() - nextBeaconTime) < 0 );
+    nextBeaconTime += PH_TDMA_BEACON_MS;
+
+    for(node=0; node<PH_NODE_MAX; node++){
+        if( (nodeHeardMask & (1 << node)) && now - nodeHeardTime[node] < PH_TDMA_ACTIVE_MS ){
+            active |= 1 << node;
+        }
+    }
+    b->frame ++;
+    b->angle = tdmaAngle;
+    b->nodeId = PH_NODE_ALL;
+    b->activeMask = active;
+    b->readyMask = nodeReadyMask;
+    MSG_DO_CHECKSUM( beacon_msg );
+    MSG_RADIO_SEND( beacon_msg );
+}
+#endif
+
+// --------------------------------------------
+// Continuous wave sweep: sample the RSSI register as fast as possible,
+// bin the samples by the slot of the phaser schedule.
+// --------------------------------------------
+void cw_sample()
+{
+    uint32_t t, tStart, total;
+    int32_t elapsed;
+    uint16_t slot, offset;
+    int noise = 0, i;
+    int rssi;
+
+    fl_cwArmed = false;
+    fl_cwAbort = false;
+    memset(cwBins, 0, sizeof(cwBins));
+
+    // Noise floor, before the carrier
+    for(i=0; i<8; i++) noise += radioGetRSSI();
+    noise /= 8;
+
+    // Carrier onset
+    t = getTimeMs();
+    while( radioGetRSSI() < noise + CW_DETECT_DB ){
+        if( getTimeMs() - t > CW_LEAD_MS + CW_DETECT_TIMEOUT_MS || fl_cwAbort ){
+            PRINTF("Cw: no carrier\n");
+            return;
+        }
+    }
+    tStart = getTimeMs() + CW_PREAMBLE_MS;
+    total = (uint32_t)cwSweep.slotCount * cwSweep.repeat * cwSweep.slotMs;
+
+    while( !fl_cwAbort ){
+        elapsed = getTimeMs() - tStart;
+        if( elapsed < 0 ) continue;
+        if( elapsed >= (int32_t)total ) break;
+
+        offset = elapsed % cwSweep.slotMs;
+        if( offset < CW_GUARD_MS || offset >= cwSweep.slotMs - CW_GUARD_MS ) continue;
+        slot = (elapsed / cwSweep.slotMs) % cwSweep.slotCount;
+
+        rssi = radioGetRSSI();
+        if( cwBins[slot].num < 0xffff ){
+            cwBins[slot].sum += rssi;
+            cwBins[slot].num ++;
+        }
+    }
+    if( fl_cwAbort ){
+        PRINTF("Cw: aborted\n");
+        return;
+    }
+
+    // Mean in 1/4 dB
+    for(slot=0; slot<cwSweep.slotCount; slot++){
+        PRINTF("Cw:\t%d\t%d\t%d\t%d\t%d\n",
+            (int) (cwSweep.expIdx + slot),
+            (int) cwSweep.configIdx,
+            (int) cwSweep.angle,
+            (int) cwBins[slot].num,
+            (int) (cwBins[slot].num ? (cwBins[slot].sum * 4) / cwBins[slot].num : 0));
+    }
+}
+
 // --------------------------------------------
 // --------------------------------------------
 inline void processTestMsg(phaser_ping_t * test, rssi_t rssi, lqi_t lqi)
@@ -173,28 +582,63 @@ inline void processTestMsg(phaser_ping_t * test, rssi_t rssi, lqi_t lqi)
     // expIdx = test->expIdx;
     // if( expIdx<0 || expIdx>= NUM_EXPS) return;
 
-    //Override caching data in array. use only one record.
-    expIdx =0;
+    //Override caching data in array. use one record per node.
+    expIdx = test->nodeId;
 
     experiment_t *exp = &(experiment[expIdx]);
 
     // exp->expIdx = test->expIdx;
 
+    exp->configIdx = test->configIdx;
     exp->power = test->power;
     exp->angle = test->angle;
-    exp->phase = test->ant.phaseA | test->ant.phaseB ;
+    exp->ant = test->ant;
+    exp->channel = test->channel;
     STREAM_STAT_ADD(exp->rssi_data, rssi);
     STREAM_STAT_ADD(exp->lqi_data, lqi);
  
-    curExp = exp;
-    lastExpIdx = test->expIdx;
+    curExp[test->nodeId] = exp;
+    lastExpIdx[test->nodeId] = test->expIdx;
+
+    checkConvergence(test, exp);
+}
+
+// --------------------------------------------
+// Test message, received or rebuilt from a compact one
+// --------------------------------------------
+void onTestMsg(phaser_ping_t * test, rssi_t rssi, lqi_t lqi)
+{
+#ifdef TDMA_BEACON
+    tdma_heard(test->nodeId);
+    if( test->nodeId == 0 ) tdma_angle(test->angle);
+#endif
+    // Check if new experiment iteration started.
+    // Aggregated by the full antenna state vector, too.
+    if( curExp[test->nodeId] && (lastExpIdx[test->nodeId] != test->expIdx
+            || !ANT_STATE_EQ(&curExp[test->nodeId]->ant, &test->ant)) ){
+        sendTestResults(test->nodeId);
+    }
+    sendEcho(test);
+    processTestMsg(test, rssi, lqi);
+}
+
+// --------------------------------------------
+// Rebuild the test message from the compact one and the anchor of its
+// node. Return NULL if the epoch is unknown.
+// --------------------------------------------
+phaser_ping_t * pingRebuild(const phaser_ping_compact_t *c)
+{
+    uint8_t node = PH_CTRL_SEQ_NODE(c->epoch);
+
+    if( node >= PH_NODE_MAX ) return NULL;
+    return ping_rebuild(&(anchor[node]), c);
 }
 
 // --------------------------------------------
 // --------------------------------------------
 void printAction(action)
 {
-    PRINTF("Rx: %s\n", MSG_ACT_NAME( action ) );
+    PRINTF("Rx: %s\n", PH_ACT_NAME( action ) );
 }
 
 // --------------------------------------------
@@ -203,6 +647,7 @@ void print_test_config(test_config_t *test_config)
 {
     int pid = test_config->platform_id;
     PRINTF("\nPlatform: %s\n", PH_PLATFORM_NAME(pid) );
+    PRINTF("Config_idx=%d\n", (int) test_config->config_idx);
 
     PRINTF("Start_delay=%d\tSend_delay=%d\t Send_count=%d\n",
         (int) test_config->start_delay,
@@ -213,6 +658,10 @@ void print_test_config(test_config_t *test_config)
         (int) test_config->angle_step,
         (int) test_config->angle_count);
 
+    PRINTF("Send_count_min=%d\tConverge_ci=%d\n",
+        (int) test_config->send_count_min,
+        (int) test_config->converge_ci);
+
     int pw, i=0;
     PRINTF("TX_power:")
     while( (pw=test_config->power[i++]) ){
@@ -227,6 +676,20 @@ void print_test_config(test_config_t *test_config)
         (int) test_config->ant.phaseB.start,
         (int) test_config->ant.phaseB.step,
         (int) test_config->ant.phaseB.count);
+    PRINTF("Ant_order=%d\tAnt_encoding=%d\tSweep_mode=%d\tSearch_coarse=%d\tTrack_step=%d\tTrack_hyst=%d\tSettle_tol=%d\tEcho=%d\n",
+        (int) test_config->ant_order,
+        (int) test_config->ant_encoding,
+        (int) test_config->sweep_mode,
+        (int) test_config->search_coarse,
+        (int) test_config->track_step,
+        (int) test_config->track_hyst,
+        (int) test_config->settle_tol,
+        (int) test_config->echo);
+    PRINTF("Channel_config:\t%d\t%d\t%d\n",
+        (int) test_config->channel.start,
+        (int) test_config->channel.step,
+        (int) test_config->channel.count);
+    PRINTF("Dim_order=%x\n", (unsigned) test_config->dim_order);
 
     PRINTF("\n");
 }
@@ -283,14 +746,30 @@ void onRadioRecv(void)
     }
 
     if( ! MSG_SIGNATURE_OK(radioBuffer) ) { flRxProcessing = false; return; }
+    lastRxTime = getTimeMs();
 
     // Anticipated payload types.
     MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_ping_t, test_data_p);
     MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_control_t, ctrl_data_p);
     MSG_NEW_PAYLOAD_PTR(radioBuffer, msg_text_data_t, msg_text_p);
     MSG_NEW_PAYLOAD_PTR(radioBuffer, test_config_t, test_config_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_result_t, result_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_session_t, session_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_config_ack_t, config_ack_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_cw_t, cw_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_echo_result_t, echo_result_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_channel_t, channel_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_angle_t, angle_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_beacon_t, beacon_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_shard_t, shard_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_ping_compact_t, compact_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_anchor_t, anchor_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_trace_t, trace_p);
 
     int act = MSG_ACT_CLEAR;
+    phaser_ping_t *ping;
+    ping_anchor_t *an;
+    uint8_t i;
     bool flOK=true;
 
     switch( radioBuffer.id ){
@@ -300,15 +779,90 @@ void onRadioRecv(void)
             PRINTF("BadChk\n");
             break;
         }
-        // Check if new experiment iteration started.
-        if(lastExpIdx != test_data_p->expIdx && curExp){
-            sendTestResults();
+        if( test_data_p->nodeId >= PH_NODE_MAX ) break;
+        onTestMsg(test_data_p, rssi, lqi);
+        break;
+
+    case PH_MSG_TestCompact:
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_ping_compact_t, flOK=false );
+        if( !flOK ){
+            PRINTF("BadChk\n");
+            break;
+        }
+        ping = pingRebuild(compact_p);
+        if( ping ) onTestMsg(ping, rssi, lqi);
+        break;
+
+    case PH_MSG_Trace:
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_trace_t, break );
+        // Entry lines for src/tools/trace_hist.py
+        if( trace_p->action == MSG_ACT_SET && trace_p->count <= PH_TRACE_CHUNK ){
+            for(i=0; i<trace_p->count; i++){
+                PRINTF("Trace:\t%d\t%u\t%u\t%d\t%d\n",
+                    (int) trace_p->nodeId,
+                    (unsigned) (trace_p->idx + i),
+                    (unsigned) trace_p->e[i].ticks,
+                    (int) trace_p->e[i].phase,
+                    (int) trace_p->e[i].arg);
+            }
+        }
+        else if( trace_p->action == MSG_ACT_DONE ){
+            PRINTF("TraceEnd:\t%d\t%u\t%u\t%lu\n",
+                (int) trace_p->nodeId,
+                (unsigned) trace_p->idx,
+                (unsigned) trace_p->lost,
+                (unsigned long) trace_p->tickHz);
         }
-        processTestMsg(test_data_p, rssi, lqi);
+        break;
+
+    case PH_MSG_Anchor:
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_anchor_t, break );
+        if( anchor_p->nodeId >= PH_NODE_MAX ) break;
+        // No ACK without the config, the phaser sends the full pings
+        if( anchor_p->configIdx >= CONFIG_STORE_MAX ) break;
+        if( configStore[anchor_p->configIdx].send_count == 0 ) break;
+        if( !ctrl_rx_seq(anchor_p->seq) ) break;
+        sendAllResults();
+
+        an = &(anchor[anchor_p->nodeId]);
+        PRINTF("Anchor:\t%d\t%d\t%d\t%d\t%d\t%d\t%u\n",
+            (int) anchor_p->nodeId,
+            (int) (anchor_p->epoch & PH_EPOCH_MASK),
+            (int) anchor_p->configIdx,
+            (int) anchor_p->expIdx,
+            (int) anchor_p->angle,
+            (int) anchor_p->step,
+            (unsigned) an->lost);
+        ping_anchor_set(an, anchor_p, &(configStore[anchor_p->configIdx]));
+        break;
+
+    case PH_MSG_EchoResult:
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_echo_result_t, break );
+        sendAllResults();
+        // Columns as Test:, but RSSI in 1/4 dB and the pings sent last
+        PRINTF("Echo:"
+            "\t%d\t%d"
+            "\t%d\t%d\t%s"
+            "\t%d\t%d\t%d"
+            "\t%ld\t%d\t%d\n",
+            (int) echo_result_p->expIdx,
+            (int) echo_result_p->configIdx,
+            (int) echo_result_p->power,
+            (int) echo_result_p->angle,
+            antStr(&echo_result_p->ant),
+            (int) echo_result_p->num,
+            (int) echo_result_p->rssi,
+            (int) echo_result_p->lqi,
+            (long unsigned int) echo_result_p->rssiDevSq,
+            (int) echo_result_p->sent,
+            (int) echo_result_p->nodeId);
         break;
     
     case PH_MSG_Angle:
-        if(curExp) sendTestResults();
+        sendAllResults();
+#ifdef TDMA_BEACON
+        if( angle_p->action == MSG_ACT_ACK ) tdma_angle(angle_p->angle);
+#endif
         if( flRestart ){        // Best time to resend the restart message after the angle change
             send_ctrl_msg(MSG_ACT_RESTART);
             flRestart = false;
@@ -317,7 +871,8 @@ void onRadioRecv(void)
 
     case PH_MSG_Control:
         MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_control_t, break);
-        if(curExp) sendTestResults();
+        if( !ctrl_rx_seq(ctrl_data_p->seq) ) break;
+        sendAllResults();
 
         act = ctrl_data_p->action;
         if(act == MSG_ACT_START ){
@@ -326,17 +881,132 @@ void onRadioRecv(void)
         printAction(act);
         break;
 
+    case PH_MSG_Result:
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_result_t, break );
+        if( result_p->action == MSG_ACT_STATUS ){
+            if( result_p->nodeId < PH_NODE_MAX ) sendResult(result_p->expIdx, result_p->nodeId);
+        }
+        else if( result_p->action == MSG_ACT_DONE ){
+            sendAllResults();
+            PRINTF("Best:\t%d\t%s\t%d\t%d\n",
+                (int) result_p->angle,
+                antStr(&result_p->ant),
+                (int) result_p->rssi,
+                (int) result_p->num);
+        }
+        else if( result_p->action == MSG_ACT_SET ){
+            sendAllResults();
+            PRINTF("Settle:\t%d\t%d\t%u\n",
+                (int) result_p->angle,
+                (int) result_p->rssi,
+                (unsigned) result_p->num);
+        }
+        break;
+
     case PH_MSG_Text:
         MSG_CHECK_FOR_PAYLOAD(radioBuffer, msg_text_data_t, break );
         PRINTF(msg_text_p->text);
         PRINTF("\n");
         break;
 
+    case PH_MSG_Session:
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_session_t, break );
+        if( !ctrl_rx_seq(session_p->seq) ) break;
+        sendAllResults();
+
+        session_p->name[PH_SESSION_NAME_LEN-1] = 0;
+        PRINTF(session_p->name);
+        PRINTF("\n");
+        PRINTF("Config received:\n");
+        print_test_config(&(session_p->config));
+        if( session_p->config.config_idx < CONFIG_STORE_MAX ){
+            memcpy(&(configStore[session_p->config.config_idx]), &(session_p->config), sizeof(test_config_t));
+        }
+        if( session_p->action == MSG_ACT_START ){
+            flRestart = false;  // Clear restart command attempt
+            printAction(MSG_ACT_START);
+        }
+        break;
+
+    case PH_MSG_Cw:
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_cw_t, break );
+        if( !ctrl_rx_seq(cw_p->seq) ) break;
+        sendAllResults();
+        if( cw_p->action == MSG_ACT_START && cw_p->slotCount <= CW_SLOT_MAX
+                && cw_p->slotMs >= CW_SLOT_MS_MIN ){
+            memcpy(&cwSweep, cw_p, sizeof(phaser_cw_t));
+            fl_cwArmed = true;
+        }
+        else {
+            fl_cwAbort = true;
+        }
+        break;
+
+#ifdef TDMA_BEACON
+    case PH_MSG_Beacon:
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_beacon_t, break );
+        // A node waiting for the next angle
+        if( beacon_p->nodeId >= PH_NODE_MAX ) break;
+        tdma_heard(beacon_p->nodeId);
+        if( beacon_p->angle != tdmaAngle ) nodeReadyMask |= 1 << beacon_p->nodeId;
+        break;
+#endif
+
+    case PH_MSG_Shard:
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_shard_t, break );
+        if( shard_p->action == MSG_ACT_SET ) break;     // Own request
+        sendAllResults();
+        PRINTF("Shard:\t%d\t%d\t%d\t%ld\t%ld\t%s\n",
+            (int) shard_p->shardIdx,
+            (int) shard_p->shardCount,
+            (int) shard_p->mode,
+            (long) shard_p->first,
+            (long) shard_p->end,
+            MSG_ACT_NAME( shard_p->action ));
+        break;
+
+    case PH_MSG_Channel:
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_channel_t, break );
+        // The ACK goes out on the old channel
+        if( !ctrl_rx_seq(channel_p->seq) ) break;
+        sendAllResults();
+        if( channel_p->channel >= PH_CHANNEL_MIN && channel_p->channel <= PH_CHANNEL_MAX ){
+            radioSetChannel(channel_p->channel);
+            radioChannel = channel_p->channel;
+        }
+        break;
+
+    case PH_MSG_ConfigAck:
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_config_ack_t, break );
+        sendAllResults();
+        PRINTF("ConfigAck:\t%d\t%d\t%d\t%s\n",
+            (int) config_ack_p->epoch,
+            (int) config_ack_p->configIdx,
+            (int) config_ack_p->expIdx,
+            PH_ACT_NAME( config_ack_p->action ));
+        if( config_ack_p->action == PH_ACT_INCOMPLETE ){
+            PRINTF("ConfigAck: TLV config incomplete, send it again\n");
+        }
+        // The new config applies to the entry from now on. The phaser
+        // sends it before the ACK: ask again if it was lost.
+        if( config_ack_p->action == MSG_ACT_ACK && config_ack_p->configIdx < CONFIG_STORE_MAX
+                && configRecvIdx != config_ack_p->configIdx ){
+            PRINTF("ConfigAck: config lost, requested\n");
+            configStoreInvalidate(config_ack_p->configIdx);
+            send_ctrl_msg(MSG_ACT_STATUS);
+        }
+        configRecvIdx = -1;
+        break;
+
     case PH_MSG_Config:
         MSG_CHECK_FOR_PAYLOAD(radioBuffer, test_config_t, break );
         PRINTF("Config received:\n");
         // TODO: parse the config and print
         print_test_config(test_config_p);
+        if( test_config_p->config_idx < CONFIG_STORE_MAX ){
+            memcpy(&(configStore[test_config_p->config_idx]), test_config_p, sizeof(test_config_t));
+            configRecvIdx = test_config_p->config_idx;
+        }
     }
 
 
@@ -347,6 +1017,8 @@ void onRadioRecv(void)
 // --------------------------------------------
 void appMain(void)
 {
+    int i;
+
     serialEnableRX(PRINTF_SERIAL_ID);
     // serialSetReceiveHandle(PRINTF_SERIAL_ID, onSerRecv);
     serialSetPacketReceiveHandle(PRINTF_SERIAL_ID, onSerRecv, serBuffer, SER_BUF_SIZE);
@@ -359,7 +1031,20 @@ void appMain(void)
     send_ctrl_msg(MSG_ACT_RESTART);
 
     while (1) {
-        mdelay(RATE_DELAY);
+        for(i=0; i<RATE_DELAY/CW_POLL_MS && !fl_cwArmed; i++){
+            mdelay(CW_POLL_MS);
+#ifdef TDMA_BEACON
+            tdma_beacon_tick();
+#endif
+        }
+        if( fl_cwArmed ) cw_sample();
+
+        // Lost the phaser on the test channel
+        if( radioChannel != PH_CHANNEL_HOME && getTimeMs() - lastRxTime > PH_CHANNEL_IDLE_MS ){
+            PRINTF("Channel: back to %d\n", (int)PH_CHANNEL_HOME);
+            radioSetChannel(PH_CHANNEL_HOME);
+            radioChannel = PH_CHANNEL_HOME;
+        }
         led0Toggle();
     }
 }
@@ -0,0 +1,51 @@
+// --------------------------------------------
+// Compact pings rebuilt from the anchor.
+// See ping_rebuild.h
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "../phaser_msg.h"
+
+#include "ping_rebuild.h"
+
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+bool ping_anchor_set(ping_anchor_t *an, const phaser_anchor_t *a, const test_config_t *cfg)
+{
+    memcpy(&(an->a), a, sizeof(phaser_anchor_t));
+    schedule_init(&(an->sched), cfg, NULL);
+    an->valid = an->sched.count > 0;
+    an->flPing = false;
+    an->lost = 0;
+    return an->valid;
+}
+
+// -------------------------------------------------------------------------
+// The full sweep is deterministic from the anchor: the angle and the
+// schedule step follow from the expIdx offset.
+// -------------------------------------------------------------------------
+phaser_ping_t * ping_rebuild(ping_anchor_t *an, const phaser_ping_compact_t *c)
+{
+    phaser_ping_t *p;
+    test_loop_t idx;
+    uint32_t d;
+
+    if( !an->valid || an->a.epoch != c->epoch ){
+        an->lost++;
+        return NULL;
+    }
+    p = &(an->ping);
+    p->msgCounter = c->seq;
+    if( an->flPing && p->expIdx == c->expIdx ) return p;
+
+    d = (uint16_t)(c->expIdx - an->a.expIdx) + an->a.step;
+    p->expIdx = c->expIdx;
+    p->angle = an->a.angle + (d / an->sched.count) * an->sched.cfg->angle_step;
+    p->configIdx = an->a.configIdx;
+    p->nodeId = an->a.nodeId;
+    schedule_step(&(an->sched), d % an->sched.count, &idx, p);
+    an->flPing = true;
+    return p;
+}
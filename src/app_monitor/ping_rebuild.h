@@ -0,0 +1,35 @@
+// --------------------------------------------
+// Compact pings: the test message rebuilt from the sweep position of the
+// node (the anchor) and the schedule of its config. The schedule is the
+// one of the phaser, see app_phaser/schedule.c.
+// --------------------------------------------
+
+#ifndef _ping_rebuild_h_
+#define _ping_rebuild_h_
+
+#include "stdmansos.h"
+
+#include "../phaser_msg.h"
+#include "../app_phaser/schedule.h"
+
+typedef struct
+{
+    phaser_anchor_t a;
+    schedule_t sched;
+    phaser_ping_t ping;
+    bool valid;         // Anchor known
+    bool flPing;        // ping is rebuilt for ping.expIdx
+    uint16_t lost;      // Compact pings of an unknown epoch
+} ping_anchor_t;
+
+
+// Set the anchor, cfg is the config it names. Clears the lost count.
+// Return false if the config has no steps.
+bool ping_anchor_set(ping_anchor_t *an, const phaser_anchor_t *a, const test_config_t *cfg);
+
+// Rebuild the test message of the node from the compact one.
+// The schedule step is decoded once per experiment.
+// Return NULL if the epoch is not the one of the anchor.
+phaser_ping_t * ping_rebuild(ping_anchor_t *an, const phaser_ping_compact_t *c);
+
+#endif // _ping_rebuild_h_
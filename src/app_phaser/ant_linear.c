@@ -0,0 +1,35 @@
+// --------------------------------------------
+// Antenna state of the linear drivers (Phaser, PhaserTx): start + k*step
+// in the two sweep dimensions, ANT_FORMAT_2x8. Also linked by the
+// monitor, to rebuild the compact pings, and by the host tests.
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "../phaser_msg.h"
+
+#include "antenna_driver.h"
+
+
+const bool ant_state_linear = true;
+
+// -------------------------------------------------------------------------
+// Sweep dimensions of the antenna configuration.
+// PhaserTx phase and attenuation share the fields of phaseA and phaseB.
+// -------------------------------------------------------------------------
+void ant_test_dims(const test_config_t *cfg, uint16_t *countA, uint16_t *countB)
+{
+    *countA = cfg->ant.phaseA.count;
+    *countB = cfg->ant.phaseB.count;
+}
+
+
+// -------------------------------------------------------------------------
+// Antenna state for the value positions in the sweep dimensions
+// -------------------------------------------------------------------------
+void ant_test_state(const test_config_t *cfg, uint16_t kA, uint16_t kB, ant_state_t *ant)
+{
+    ANT_STATE_CLEAR(ant, ANT_FORMAT_2x8);
+    ant->phaseA = cfg->ant.phaseA.start + kA * cfg->ant.phaseA.step;
+    ant->phaseB = cfg->ant.phaseB.start + kB * cfg->ant.phaseB.step;
+}
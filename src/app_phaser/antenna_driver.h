@@ -33,19 +33,45 @@
 //===========================================
 
 // Set of test configurations that should be executed
-extern test_config_t testSet[];
+extern const test_config_t testSet[];
 extern const size_t testSet_size;
 
 
 extern char *ant_driver_name;
 
+// The state is start + k*step in the two dimensions, ANT_FORMAT_2x8,
+// so the monitor can rebuild it for the compact pings. The linear
+// drivers link ant_linear.c for it, and for the two functions below.
+extern const bool ant_state_linear;
+
 void ant_driver_init();
 
-bool ant_test_sanity_check(test_config_t *newTest);
-void ant_test_init(test_loop_t *testIdx, test_config_t *test_config, phaser_ping_t *ant_cfg_p);
-bool ant_test_next_config(test_loop_t *testIdx, test_config_t *test_config, phaser_ping_t *ant_cfg_p);
+bool ant_test_sanity_check(const test_config_t *newTest);
+
+// Number of values in the two antenna sweep dimensions (0: not swept)
+void ant_test_dims(const test_config_t *cfg, uint16_t *countA, uint16_t *countB);
+// Antenna state for the value positions kA, kB in the two dimensions:
+// all the element states and the format, see ANT_STATE_CLEAR().
+// A board with more elements maps the two dimensions to its vector.
+void ant_test_state(const test_config_t *cfg, uint16_t kA, uint16_t kB, ant_state_t *ant);
+// Config of the states staged from now on (ant_encoding etc.)
+void ant_test_config(const test_config_t *cfg);
+
 void ant_test_setup(phaser_ping_t *ant_cfg_p);
 
+// Split setup, for overlapping the reconfiguration with the radio TX:
+//  stage - prepare the hardware words for the state, no output change
+//  latch - apply the staged state to the hardware
+//  settle - wait until the latched state is stable
+void ant_test_stage(ant_state_t *ant);
+void ant_test_latch();
+void ant_test_settle();
+
+// Settle time used by ant_test_settle(), from the calibration, us.
+// ANT_SETTLE_DEFAULT: the built-in one of the driver.
+#define ANT_SETTLE_DEFAULT 0xffff
+void ant_test_set_settle(uint16_t us);
+
 bool ant_check_button();
 
 #endif // _antenna_driver_h_
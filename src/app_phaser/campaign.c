@@ -0,0 +1,217 @@
+// --------------------------------------------
+// Campaign planner: runs all testSet[] entries in a single angle sweep.
+// See campaign.h
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "../phaser_msg.h"
+
+#include "campaign.h"
+#include "schedule.h"
+
+
+#define ANGLE_MAP_SET(map, a)   ((map)[(a) >> 3] |= (1 << ((a) & 7)))
+#define ANGLE_MAP_GET(map, a)   ((map)[(a) >> 3] & (1 << ((a) & 7)))
+
+
+// -------------------------------------------------------------------------
+// Entry properties used by the cost model
+// -------------------------------------------------------------------------
+static tx_power_t power_first(const test_config_t *cfg)
+{
+    return cfg->power[0];
+}
+
+static tx_power_t power_last(const test_config_t *cfg)
+{
+    int i;
+    for(i=1; i<TEST_CONFIG_POWER_LIST_SIZE && cfg->power[i]; i++);
+    return cfg->power[i-1];
+}
+
+static uint8_t channel_last(const test_config_t *cfg)
+{
+    if( cfg->channel.count == 0 ) return schedule_channel(cfg, 0);
+    return schedule_channel(cfg, cfg->channel.count - 1);
+}
+
+// First and last antenna state of the entry sweep.
+// Uses the phaseA/phaseB layout, the same for all the platforms.
+static uint16_t ant_value(const iter8_config_t *it, bool last)
+{
+    if( !last || it->count == 0 ) return it->start;
+    return (uint8_t) (it->start + it->step * (it->count - 1));
+}
+
+static uint16_t ant_first(const test_config_t *cfg)
+{
+    return ant_value(&cfg->ant.phaseA, false) | (ant_value(&cfg->ant.phaseB, false) << 8);
+}
+
+static uint16_t ant_last(const test_config_t *cfg)
+{
+    return ant_value(&cfg->ant.phaseA, true) | (ant_value(&cfg->ant.phaseB, true) << 8);
+}
+
+// -------------------------------------------------------------------------
+// Cost of switching from the end of one entry to the start of another one
+// -------------------------------------------------------------------------
+static uint32_t transition_cost(const test_config_t *from, const test_config_t *to)
+{
+    uint32_t cost = 0;
+    if( ant_last(from) != ant_first(to) ) cost += CAMPAIGN_COST_SETTLE_MS;
+    if( power_last(from) != power_first(to) ) cost += CAMPAIGN_COST_POWER_MS;
+    if( channel_last(from) != schedule_channel(to, 0) ) cost += CAMPAIGN_COST_CHANNEL_MS;
+    return cost;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+bool campaign_entry_has_angle(const test_config_t *cfg, angle_t angle)
+{
+    if( cfg->angle_count == 0 ) return angle == 0;
+    if( cfg->angle_step == 0 ) return angle == 0;
+    if( angle % cfg->angle_step ) return false;
+    return (angle / cfg->angle_step) < cfg->angle_count;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+int campaign_next_angle(campaign_plan_t *plan, int angle)
+{
+    if( plan->descending ){
+        if( angle < 0 ) angle = CAMPAIGN_ANGLE_MAX;
+        for(angle--; angle>=0; angle--){
+            if( ANGLE_MAP_GET(plan->angleMap, angle) ) return angle;
+        }
+        return -1;
+    }
+    for(angle++; angle<CAMPAIGN_ANGLE_MAX; angle++){
+        if( ANGLE_MAP_GET(plan->angleMap, angle) ) return angle;
+    }
+    return -1;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+uint8_t campaign_entry(campaign_plan_t *plan, int angleNum, int pos)
+{
+    if( plan->serpentine && (angleNum & 1) ){
+        pos = plan->entryCount - 1 - pos;
+    }
+    return plan->entryOrder[pos];
+}
+
+// -------------------------------------------------------------------------
+// Overhead of the merged plan, with or without the serpentine order.
+// The same in both angle directions.
+// -------------------------------------------------------------------------
+static uint32_t merged_cost(campaign_plan_t *plan, const test_config_t *set)
+{
+    // One homing, the configs of all the entries
+    uint32_t cost = CAMPAIGN_COST_HOME_MS + plan->entryCount * CAMPAIGN_COST_CONFIG_MS;
+    int angle = -1, prevAngle = 0, angleNum = 0;
+    int pos;
+    const test_config_t *prev = NULL, *cfg;
+
+    while( (angle = campaign_next_angle(plan, angle)) >= 0 ){
+        if( angleNum > 0 ){
+            cost += CAMPAIGN_COST_MOVE_MS + CAMPAIGN_COST_STEP_MS * (angle - prevAngle);
+        }
+        for(pos=0; pos<plan->entryCount; pos++){
+            cfg = &set[campaign_entry(plan, angleNum, pos)];
+            if( !campaign_entry_has_angle(cfg, angle) ) continue;
+            if( prev ) cost += transition_cost(prev, cfg);
+            prev = cfg;
+        }
+        prevAngle = angle;
+        angleNum++;
+    }
+    return cost;
+}
+
+// -------------------------------------------------------------------------
+// Overhead of running the entries one by one
+// -------------------------------------------------------------------------
+static uint32_t sequential_cost(const test_config_t *set, size_t size)
+{
+    uint32_t cost = 0;
+    size_t i;
+    const test_config_t *cfg;
+
+    for(i=0; i<size; i++){
+        cfg = &set[i];
+        cost += CAMPAIGN_COST_HOME_MS + CAMPAIGN_COST_CONFIG_MS;
+        if( cfg->angle_count > 1 ){
+            cost += (uint32_t)(cfg->angle_count - 1) *
+                (CAMPAIGN_COST_MOVE_MS + CAMPAIGN_COST_STEP_MS * cfg->angle_step);
+        }
+        // Each angle starts the antenna sweep over again
+        cost += (uint32_t)cfg->angle_count * transition_cost(cfg, cfg);
+    }
+    return cost;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+bool campaign_plan(campaign_plan_t *plan, const test_config_t *set, size_t size)
+{
+    size_t i, j, k;
+    uint32_t c, best, costFixed;
+    uint8_t used[CAMPAIGN_ENTRY_MAX];
+    angle_t a;
+
+    memset(plan, 0, sizeof(campaign_plan_t));
+    plan->merged = false;
+
+    if( size < 2 || size > CAMPAIGN_ENTRY_MAX ) return false;
+
+    // Angles of all the entries
+    for(i=0; i<size; i++){
+        // Tracking never ends, the other entries would not run
+        if( set[i].sweep_mode == SWEEP_MODE_TRACK ) return false;
+        if( set[i].angle_count == 0 ){
+            ANGLE_MAP_SET(plan->angleMap, 0);
+            continue;
+        }
+        for(j=0; j<set[i].angle_count; j++){
+            a = j * set[i].angle_step;
+            if( a >= CAMPAIGN_ANGLE_MAX ) return false;
+            ANGLE_MAP_SET(plan->angleMap, a);
+        }
+    }
+
+    // Entry order: start from the first entry, then the cheapest transition
+    memset(used, 0, sizeof(used));
+    plan->entryCount = size;
+    plan->entryOrder[0] = 0;
+    used[0] = 1;
+    for(i=1; i<size; i++){
+        best = 0xffffffff;
+        for(j=0; j<size; j++){
+            if( used[j] ) continue;
+            c = transition_cost(&set[plan->entryOrder[i-1]], &set[j]);
+            if( c < best ){
+                best = c;
+                k = j;
+            }
+        }
+        plan->entryOrder[i] = k;
+        used[k] = 1;
+    }
+
+    // Fixed or serpentine entry order
+    plan->serpentine = false;
+    costFixed = merged_cost(plan, set);
+    plan->serpentine = true;
+    plan->costMerged = merged_cost(plan, set);
+    if( costFixed <= plan->costMerged ){
+        plan->serpentine = false;
+        plan->costMerged = costFixed;
+    }
+
+    plan->costSequential = sequential_cost(set, size);
+    plan->merged = plan->costMerged < plan->costSequential;
+    return plan->merged;
+}
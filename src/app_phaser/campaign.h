@@ -0,0 +1,64 @@
+// --------------------------------------------
+// Campaign planner: runs all testSet[] entries in a single angle sweep.
+//
+// Each angle is visited once and every entry that covers it is run there.
+// The entry order is chosen with a cost model of the stepper moves,
+// antenna settle and TX power switches, and may alternate between the
+// angles (serpentine), so the last entry at one angle is the first one
+// at the next angle.
+// The angles are visited in either direction: a campaign restarted at
+// its end runs back from the last angle, without the stepper homing.
+// --------------------------------------------
+
+#ifndef _campaign_h_
+#define _campaign_h_
+
+#include "stdmansos.h"
+
+#include "../phaser_msg.h"
+
+#include "rto.h"
+
+// Angles are kept as a bitmap, in stepper steps
+#define CAMPAIGN_ANGLE_MAX  256
+#define CAMPAIGN_ENTRY_MAX  16
+
+// Cost model, ms. Not measured; from the delays in the code:
+// app_stepper/stepper.c: 2 x DELAY_STEP per step, DELAY_START + DELAY_BRAKE
+// per move. The reliable messages: one round trip, bounded by the first
+// retransmission timeout. The settle: the driver default, 1000 us.
+#define CAMPAIGN_COST_STEP_MS       20      // one stepper step
+#define CAMPAIGN_COST_MOVE_MS       230     // stepper start/brake, + the angle message round trip
+#define CAMPAIGN_COST_HOME_MS       1500    // test_init(): to -20 and back to 0, 40 steps and 2 moves
+#define CAMPAIGN_COST_CONFIG_MS     RTO_INITIAL_MS  // test_start(): one session message per entry
+#define CAMPAIGN_COST_SETTLE_MS     1       // antenna state change
+#define CAMPAIGN_COST_POWER_MS      1       // TX power change, one CC2420 register write
+#define CAMPAIGN_COST_CHANNEL_MS    RTO_INITIAL_MS  // channel_set(): one reliable message
+
+typedef struct
+{
+    uint8_t angleMap[CAMPAIGN_ANGLE_MAX/8];     // angles visited by any entry
+    uint8_t entryOrder[CAMPAIGN_ENTRY_MAX];     // entry order at even angles
+    uint8_t entryCount;
+    bool merged;        // false: run the entries one by one, as before
+    bool serpentine;    // reverse the entry order at odd angles
+    bool descending;    // visit the angles from the highest one
+    uint32_t costMerged;        // estimated overhead, ms
+    uint32_t costSequential;    // estimated overhead, ms
+} campaign_plan_t;
+
+
+// Build the plan for the test set. Return true if the merged plan is used.
+bool campaign_plan(campaign_plan_t *plan, const test_config_t *set, size_t size);
+
+// Return true if the entry visits the angle
+bool campaign_entry_has_angle(const test_config_t *cfg, angle_t angle);
+
+// Next angle of the plan after the given one (-1 for the first), in the
+// plan direction. Return -1 when no more angles.
+int campaign_next_angle(campaign_plan_t *plan, int angle);
+
+// testSet[] index of the entry at the position for the n-th visited angle
+uint8_t campaign_entry(campaign_plan_t *plan, int angleNum, int pos);
+
+#endif // _campaign_h_
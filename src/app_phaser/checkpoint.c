@@ -0,0 +1,193 @@
+// --------------------------------------------
+// Checkpoint of the campaign sweep cursor in the MSP430 info flash.
+// See checkpoint.h
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "checkpoint.h"
+#include "antenna_driver.h"
+
+
+#define CHECKPOINT_MAGIC    0x4350      // "CP"
+
+// Info flash: segment B at 0x1000, segment A at 0x1080 (MSP430F1611)
+#define CP_SEG_ADDR(seg)    ((uint8_t *)(uintptr_t)(0x1000 + (seg) * CP_SEG_SIZE))
+#define CP_SEG_SIZE         128
+#define CP_SLOTS            (CP_SEG_SIZE / sizeof(checkpoint_t))
+
+// 4 records per segment, see checkpoint.h
+typedef char cp_record_size_check[(sizeof(checkpoint_t) <= CP_RECORD_MAX) ? 1 : -1];
+#define CP_SLOT_ADDR(seg, slot) ((checkpoint_t *)(CP_SEG_ADDR(seg) + (slot) * sizeof(checkpoint_t)))
+
+// Flash timing generator: MCLK / (FN+1) in 257 - 476 kHz
+#define CP_FLASH_FN         ((CPU_HZ / 400000ul) - 1)
+
+// Place of the next record
+static uint8_t cpSeg = 0;
+static uint8_t cpSlot = 0;
+static uint16_t cpSeq = 0;
+
+// The latest record, rewritten with a new settle time
+static checkpoint_t cpLast = { .settleUs = ANT_SETTLE_DEFAULT };
+
+
+// -------------------------------------------------------------------------
+// Flash access. Interrupts are off, the CPU is held while the flash
+// controller is busy.
+// -------------------------------------------------------------------------
+static void flash_erase(uint8_t seg)
+{
+    Handle_t h;
+    ATOMIC_START(h);
+    FCTL2 = FWKEY | FSSEL_1 | CP_FLASH_FN;
+    FCTL3 = FWKEY;
+    FCTL1 = FWKEY | ERASE;
+    *CP_SEG_ADDR(seg) = 0;          // Dummy write starts the erase
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY | LOCK;
+    ATOMIC_END(h);
+}
+
+static void flash_write(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    Handle_t h;
+    ATOMIC_START(h);
+    FCTL2 = FWKEY | FSSEL_1 | CP_FLASH_FN;
+    FCTL3 = FWKEY;
+    FCTL1 = FWKEY | WRT;
+    while( len-- ) *dst++ = *src++;
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY | LOCK;
+    ATOMIC_END(h);
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+uint16_t checkpoint_sum(const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    uint16_t s1 = 0, s2 = 0;
+    while( len-- ){
+        s1 = (s1 + *p++) % 255;
+        s2 = (s2 + s1) % 255;
+    }
+    return (s2 << 8) | s1;
+}
+
+static bool record_valid(const checkpoint_t *cp)
+{
+    if( cp->magic != CHECKPOINT_MAGIC ) return false;
+    return cp->sum == checkpoint_sum(cp, offsetof(checkpoint_t, sum));
+}
+
+static bool slot_blank(uint8_t seg, uint8_t slot)
+{
+    const uint8_t *p = (const uint8_t *)CP_SLOT_ADDR(seg, slot);
+    size_t i;
+    for(i=0; i<sizeof(checkpoint_t); i++){
+        if( p[i] != 0xff ) return false;
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// Find the latest record, keep a copy in cpLast.
+// Return false if there is no valid record.
+// -------------------------------------------------------------------------
+static bool record_find()
+{
+    const checkpoint_t *rec, *latest = NULL;
+    uint8_t seg, slot;
+
+    for(seg=0; seg<2; seg++){
+        for(slot=0; slot<CP_SLOTS; slot++){
+            rec = CP_SLOT_ADDR(seg, slot);
+            if( !record_valid(rec) ) continue;
+            if( latest && (int16_t)(rec->seq - latest->seq) <= 0 ) continue;
+            latest = rec;
+            cpSeg = seg;
+            cpSlot = slot + 1;
+        }
+    }
+    if( !latest ){
+        cpSeg = 0;
+        cpSlot = CP_SLOTS;      // Erase before the first write
+        cpSeq = 0;
+        memset(&cpLast, 0, sizeof(cpLast));
+        cpLast.settleUs = ANT_SETTLE_DEFAULT;
+        return false;
+    }
+    cpSeq = latest->seq;
+    memcpy(&cpLast, latest, sizeof(checkpoint_t));
+    return true;
+}
+
+static void record_write(checkpoint_t *cp)
+{
+    if( cpSlot >= CP_SLOTS || !slot_blank(cpSeg, cpSlot) ){
+        // The latest record stays in the old segment until this one is written
+        cpSeg ^= 1;
+        cpSlot = 0;
+        flash_erase(cpSeg);
+    }
+
+    cp->magic = CHECKPOINT_MAGIC;
+    cp->seq = ++cpSeq;
+    cp->sum = checkpoint_sum(cp, offsetof(checkpoint_t, sum));
+
+    flash_write((uint8_t *)CP_SLOT_ADDR(cpSeg, cpSlot), (const uint8_t *)cp, sizeof(checkpoint_t));
+    cpSlot++;
+    if( cp != &cpLast ) memcpy(&cpLast, cp, sizeof(checkpoint_t));
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+bool checkpoint_load(checkpoint_t *cp)
+{
+    if( !record_find() || !(cpLast.flags & CP_FL_CURSOR) ) return false;
+    memcpy(cp, &cpLast, sizeof(checkpoint_t));
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+void checkpoint_save(checkpoint_t *cp)
+{
+    cp->flags |= CP_FL_CURSOR;
+    cp->settleUs = cpLast.settleUs;
+    cp->settleDriver = cpLast.settleDriver;
+    record_write(cp);
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+void checkpoint_clear()
+{
+    flash_erase(0);
+    flash_erase(1);
+    cpSeg = 0;
+    cpSlot = 0;
+
+    cpLast.flags = 0;
+    if( cpLast.settleUs != ANT_SETTLE_DEFAULT ) record_write(&cpLast);
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+uint16_t checkpoint_settle_load(const char *driver)
+{
+    if( !record_find() ) return ANT_SETTLE_DEFAULT;
+    if( cpLast.settleDriver != checkpoint_sum(driver, strlen(driver)) ) return ANT_SETTLE_DEFAULT;
+    return cpLast.settleUs;
+}
+
+void checkpoint_settle_save(const char *driver, uint16_t us)
+{
+    uint16_t sig = checkpoint_sum(driver, strlen(driver));
+
+    if( cpLast.settleUs == us && cpLast.settleDriver == sig ) return;
+    cpLast.settleUs = us;
+    cpLast.settleDriver = sig;
+    record_write(&cpLast);
+}
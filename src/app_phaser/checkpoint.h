@@ -0,0 +1,83 @@
+// --------------------------------------------
+// Checkpoint of the campaign sweep cursor in the MSP430 info flash.
+//
+// Records are appended to one of the two 128-byte info segments, 4 per
+// segment. When it is full, the other segment is erased and used, so the
+// last valid record survives a reset during the erase. The latest record
+// (highest seq, valid checksum) is the checkpoint.
+//
+// Each segment is erased once per 8 records. At one record per
+// CHECKPOINT_INTERVAL_MS (5 min) that is every 40 min: the 10k erase
+// cycles of the info flash (minimum, datasheet) last ~9 months of
+// campaigns. Keep the record at CP_RECORD_MAX bytes.
+//
+// Each record also carries the calibrated antenna settle time, so it
+// survives the reboots. A record without a cursor keeps only the settle
+// time, after the checkpoint is cleared.
+// --------------------------------------------
+
+#ifndef _checkpoint_h_
+#define _checkpoint_h_
+
+#include "stdmansos.h"
+
+#include "../phaser_msg.h"
+
+#define CP_RECORD_MAX       32
+
+// checkpoint_t.flags
+#define CP_FL_CURSOR        0x01    // Not set: nothing to resume, settle time only
+#define CP_FL_SHARD         0x02    // Sharded campaign, shard fields
+#define CP_FL_DESCENDING    0x04    // Merged campaign: angle direction
+
+typedef struct
+{
+    uint16_t magic;
+    uint16_t seq;               // Record counter, the highest is the latest
+    uint16_t testSetSig;        // Checksum of testSet[], rejects other firmware
+    uint8_t configCounter;      // testSet[] entry
+    uint8_t flags;              // CP_FL_*
+    uint16_t msgCounter;
+    union {
+        struct {                // Sequential or merged campaign
+            uint16_t angleIdx;  // testIdx.angle.idx, schedule_step() sets the rest
+            uint32_t schedIdx;  // Step of the sweep at the angle
+            uint16_t expIdx;
+            angle_t angle;
+            uint16_t planAngleNum;  // Merged campaign: angle number
+            uint8_t planEntryPos;   // Merged campaign: entry at the angle
+        };
+        struct {                // Sharded campaign
+            uint32_t shardCur;  // Global index
+            uint32_t shardEnd;
+            uint8_t shardStride;
+        };
+    };
+    uint16_t settleUs;          // Calibrated settle, ANT_SETTLE_DEFAULT: none
+    uint16_t settleDriver;      // checkpoint_sum() of the driver name
+    uint16_t sum;               // Checksum of the fields above
+} __attribute__((packed)) 
+checkpoint_t;
+
+
+// Find the latest checkpoint and the place for the next one.
+// Return false if there is no valid checkpoint.
+bool checkpoint_load(checkpoint_t *cp);
+
+// Append the checkpoint. Sets magic, seq and sum.
+void checkpoint_save(checkpoint_t *cp);
+
+// Erase all the checkpoints, keep the settle time
+void checkpoint_clear();
+
+// Settle time saved by the driver, ANT_SETTLE_DEFAULT if none was
+// saved or it was of another driver
+uint16_t checkpoint_settle_load(const char *driver);
+
+// Save the settle time of the driver, with the cursor of the latest record
+void checkpoint_settle_save(const char *driver, uint16_t us);
+
+// Fletcher-16 checksum
+uint16_t checkpoint_sum(const void *data, size_t len);
+
+#endif // _checkpoint_h_
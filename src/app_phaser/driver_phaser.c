@@ -10,6 +10,7 @@
 #include "../phaser_msg.h"
 
 #include "antenna_driver.h"
+#include "checkpoint.h"
 
 
 // -------------------------------------------------------------------------
@@ -22,7 +23,7 @@ char *ant_driver_name = "Phaser";
 // -------------------------------------------------------------------------
 // Set of test configurations that should be executed
 // -------------------------------------------------------------------------
-test_config_t testSet[] = {
+const test_config_t testSet[] = {
     {
         .platform_id = PLATFORM_ID,     // SuperShort test
         .start_delay = 100,
@@ -38,6 +39,25 @@ test_config_t testSet[] = {
         .ant.phaseB.count = 8,
         .power = {15, 0}
     },
+
+    // {
+    //     .platform_id = PLATFORM_ID,     // Frequency response, 16 channels
+    //     .start_delay = 100,
+    //     .send_delay  = 5,
+    //     .send_count  = 100,
+    //     .angle_step  = 25,
+    //     .angle_count = 8,
+    //     .ant.phaseA.start = 0,
+    //     .ant.phaseA.step  = 0,
+    //     .ant.phaseA.count = 0,
+    //     .ant.phaseB.start = 0,
+    //     .ant.phaseB.step  = 32,
+    //     .ant.phaseB.count = 8,
+    //     .channel.start = 11,
+    //     .channel.step  = 1,
+    //     .channel.count = 16,
+    //     .power = {31, 0}
+    // },
     
     // {
     //     .platform_id = PLATFORM_ID,     // Short test
@@ -85,6 +105,25 @@ test_config_t testSet[] = {
     //     .ant.phaseB.step  = 32,
     //     .ant.phaseB.count = 8,
     //     .power = {31, 23, 15, 7, 3, 0}
+    // },
+
+    // {
+    //     .platform_id = PLATFORM_ID,     // Beam tracking, runs until restart
+    //     .start_delay = 100,
+    //     .send_delay  = 1,
+    //     .send_count  = 20,
+    //     .angle_step  = 0,
+    //     .angle_count = 1,
+    //     .ant.phaseA.start = 0,
+    //     .ant.phaseA.step  = 8,
+    //     .ant.phaseA.count = 32,
+    //     .ant.phaseB.start = 0,
+    //     .ant.phaseB.step  = 8,
+    //     .ant.phaseB.count = 32,
+    //     .sweep_mode = SWEEP_MODE_TRACK,
+    //     .track_step = 1,
+    //     .track_hyst = 4,                // 1 dB
+    //     .power = {31, 0}
     // }
 };
 const size_t testSet_size = sizeof(testSet)/sizeof(testSet[0]);
@@ -95,76 +134,70 @@ void ant_driver_init()
 {
     PHASER_INIT();
     PHASER_SET_PARALLEL();
+    // Settle time of the last calibration
+    ant_test_set_settle(checkpoint_settle_load(ant_driver_name));
 }
 
 
 // -------------------------------------------------------------------------
 // -------------------------------------------------------------------------
-bool ant_test_sanity_check(test_config_t *newTest)
+bool ant_test_sanity_check(const test_config_t *newTest)
 {    
     return true;
 }
 
 
 // -------------------------------------------------------------------------
-// Setup the test run (Antena parameters)
 // -------------------------------------------------------------------------
-void ant_test_init(test_loop_t *testIdx, test_config_t *test_config, phaser_ping_t *ant_cfg_p)
+void ant_test_config(const test_config_t *cfg)
 {
-    // Init the iterators
-    testIdx->phaseA.idx = 0;
-    testIdx->phaseA.limit = test_config->ant.phaseA.count;
-    testIdx->phaseB.idx = 0;
-    testIdx->phaseB.limit = test_config->ant.phaseB.count;
-
-    // Init the antena configuration 
-    ant_cfg_p->ant.phaseA = test_config->ant.phaseA.start;
-    ant_cfg_p->ant.phaseB = test_config->ant.phaseB.start;
 }
 
 
+// Sweep dimensions and antenna state: ant_linear.c
+
 
 // -------------------------------------------------------------------------
-// Setup the test run
-// Return true when next iteration is ready
-// Return false when done (no more iterations possible)
+// Staged antenna state
 // -------------------------------------------------------------------------
-bool ant_test_next_config(test_loop_t *testIdx, test_config_t *test_config, phaser_ping_t *ant_cfg_p)
+static ant_state_t antStaged;
+
+void ant_test_stage(ant_state_t *ant)
 {
-    // Next phase
-    if(test_config->ant.phaseA.count){
-        testIdx->phaseA.idx++;
-        if( testIdx->phaseA.idx >= testIdx->phaseA.limit ){
-            testIdx->phaseA.idx = 0;
-            ant_cfg_p->ant.phaseA = test_config->ant.phaseA.start;
-        }
-        else {
-            ant_cfg_p->ant.phaseA += test_config->ant.phaseA.step;
-            return true;
-        }
-    } 
-    if(test_config->ant.phaseB.count){
-        testIdx->phaseB.idx++;
-        if( testIdx->phaseB.idx >= testIdx->phaseB.limit ){
-            testIdx->phaseB.idx = 0;
-            ant_cfg_p->ant.phaseB = test_config->ant.phaseB.start;
-        }
-        else {
-            ant_cfg_p->ant.phaseB += test_config->ant.phaseB.step;
-            return true;
-        }
+    antStaged = *ant;
+}
+
+void ant_test_latch()
+{
+    PHASER_A_SET(antStaged.phaseA);
+    PHASER_B_SET(antStaged.phaseB);
+}
+
+// Settle time from the calibration, us
+static uint16_t antSettleUs = ANT_SETTLE_DEFAULT;
+
+void ant_test_settle()
+{
+    if( antSettleUs == ANT_SETTLE_DEFAULT ){
+        PHASER_WAIT_SETTLE();
+    }
+    else if( antSettleUs ){
+        udelay(antSettleUs);
     }
-    return false;
 }
 
+void ant_test_set_settle(uint16_t us)
+{
+    antSettleUs = us;
+}
 
 // -------------------------------------------------------------------------
 // -------------------------------------------------------------------------
 void ant_test_setup(phaser_ping_t *ant_cfg_p)
 {
-    PHASER_A_SET(ant_cfg_p->ant.phaseA);
-    PHASER_B_SET(ant_cfg_p->ant.phaseB);
-    PHASER_WAIT_SETTLE();
+    ant_test_stage(&ant_cfg_p->ant);
+    ant_test_latch();
+    ant_test_settle();
 }
 
 
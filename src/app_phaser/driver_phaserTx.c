@@ -10,6 +10,8 @@
 #include "../phaser_msg.h"
 
 #include "antenna_driver.h"
+#include "checkpoint.h"
+#include "pe46120.h"
 
 
 // -------------------------------------------------------------------------
@@ -23,11 +25,15 @@ char *ant_driver_name = "PhaserTx";
 // Set of test configurations that should be executed
 // -------------------------------------------------------------------------
 //
-// Configuration parameters: 
-//   Phase: 6bits, ~180deg, across Channel 1 and 2
-//   Attenuation: 4 bits, 0dB - 7.5dB on channel 2
-
-test_config_t testSet[] = {
+// Configuration parameters, by .ant_encoding: 
+//   PHASERTX_ENC_NIBBLE (default), PHASERTX_ENC_CONT:
+//     Phase: 6bits, ~180deg, across Channel 1 and 2
+//     Attenuation: 4 bits, 0dB - 7.5dB on channel 2
+//   PHASERTX_ENC_DUAL:
+//     Phase: 5 bits, channel 1
+//     Attenuation: 5 bits, channel 2 phase
+
+const test_config_t testSet[] = {
     {
         .platform_id = PLATFORM_ID,     // Short test
         .start_delay = 1000,
@@ -56,6 +62,9 @@ test_config_t testSet[] = {
         .ant.attenuation.start = 0,
         .ant.attenuation.step  = 8,
         .ant.attenuation.count = 2,
+        .ant_order = SWEEP_ORDER_GRAY,
+        .send_count_min = 20,
+        .converge_ci = 2,               // 0.5 dB
         .power = {31, 0}
     },
     {
@@ -72,7 +81,78 @@ test_config_t testSet[] = {
         .ant.attenuation.step  = 4,
         .ant.attenuation.count = 4,
         .power = {31, 15, 7, 3, 0}
-    }
+    },
+    {
+        .platform_id = PLATFORM_ID,     // Beam search, best phase per angle
+        .start_delay = 1000,
+        .send_delay  = 5,
+        .send_count  = 100,
+        .angle_step  = 5,
+        .angle_count = 40,
+        .ant.phase.start = 0,
+        .ant.phase.step  = 1,
+        .ant.phase.count = 256,
+        .ant.attenuation.start = 0,
+        .ant.attenuation.step  = 8,
+        .ant.attenuation.count = 2,
+        .sweep_mode = SWEEP_MODE_SEARCH,
+        .search_coarse = 8,
+        .power = {31, 0}
+    },
+    {
+        .platform_id = PLATFORM_ID,     // Both channel phases, 5 bits x 5 bits
+        .start_delay = 1000,
+        .send_delay  = 5,
+        .send_count  = 100,
+        .angle_step  = 5,
+        .angle_count = 40,
+        .ant.phase.start = 0,           // Channel 1 phase
+        .ant.phase.step  = 1,
+        .ant.phase.count = 32,
+        .ant.attenuation.start = 0,     // Channel 2 phase
+        .ant.attenuation.step  = 1,
+        .ant.attenuation.count = 32,
+        .ant_encoding = PHASERTX_ENC_DUAL,
+        .ant_order = SWEEP_ORDER_GRAY,
+        .send_count_min = 20,
+        .converge_ci = 2,               // 0.5 dB
+        .power = {31, 0}
+    },
+
+    // {
+    //     .platform_id = PLATFORM_ID,     // Settle time calibration, put first
+    //     .start_delay = 1000,
+    //     .send_delay  = 10,
+    //     .send_count  = 50,
+    //     .angle_step  = 0,
+    //     .angle_count = 1,
+    //     .ant.phase.start = 0,           // Extreme states: 0 and 255
+    //     .ant.phase.step  = 255,
+    //     .ant.phase.count = 2,
+    //     .ant.attenuation.start = 0,
+    //     .ant.attenuation.step  = 15,
+    //     .ant.attenuation.count = 2,
+    //     .sweep_mode = SWEEP_MODE_SETTLE,
+    //     .settle_tol = 2,                // 0.5 dB
+    //     .power = {31, 0}
+    // },
+
+    // {
+    //     .platform_id = PLATFORM_ID,     // Carrier sweep, all 256 phases
+    //     .start_delay = 1000,
+    //     .send_delay  = 4,               // Slot, ms
+    //     .send_count  = 10,              // Passes
+    //     .angle_step  = 5,
+    //     .angle_count = 40,
+    //     .ant.phase.start = 0,
+    //     .ant.phase.step  = 1,
+    //     .ant.phase.count = 256,
+    //     .ant.attenuation.start = 0,
+    //     .ant.attenuation.step  = 0,
+    //     .ant.attenuation.count = 1,
+    //     .sweep_mode = SWEEP_MODE_CW,
+    //     .power = {31, 0}
+    // }
 };
 const size_t testSet_size = sizeof(testSet)/sizeof(testSet[0]);
 
@@ -85,13 +165,7 @@ PIN_DEFINE(RFCLK_, 2, 3);
 PIN_DEFINE(RFSDI_, 2, 6);
 PIN_DEFINE(RFSDO_, 2, 0);
 
-// Serial map: 
-// 14bit word: S0 S1 P0-P4 M0-M3 S2 S3 C0
-// M0-M3 - attenuation:  4 + 2 + 1 + 0.5 dB
-// P0-P4 - phase shift:  45 + 22.5 + 11.2 + 5.6 + 2.8 deg
-// C0 - channel register select 
-//      Channels: RFOUT1: phase only;  RFOUT2: attenuation and phase
-// S* - spare bits = X
+// Serial map: see pe46120.h
 
 // Timing:
 // CLK frequency: 32KHz - 26MHz
@@ -111,24 +185,34 @@ PIN_DEFINE(PhaserBtn, 1, 2);
 // Delay at least 20ns per step (PE46120 serial comm, see datasheet)
 #define STEP_DELAY()  nop()
 
+#ifdef PE46120_USE_SPI
 // -------------------------------------------------------------------------
-//  Setup PE46120 chip, one channel
+//  Send a serial word to the PE46120 chip and latch it, USART.
+//  The chip takes the word LSB first, the USART sends MSB first, 8 bits at 
+//  a time. The table holds the 14 bits reversed into the low bits of the 
+//  16-bit frame, so the 2 leading zero bits are shifted out of the chip 
+//  before LE.
+// -------------------------------------------------------------------------
+void pe46120_send_word(uint16_t frame)
+{
+    RFLE_Low();
+    spiWriteByte(PE46120_SPI_BUS, frame >> 8);
+    spiWriteByte(PE46120_SPI_BUS, frame & 0xff);
+    // spiWriteByte() returns when the last bit is out
+    RFLE_High();
+}
+
+#else
+// -------------------------------------------------------------------------
+//  Send a 14-bit serial word to the PE46120 chip and latch it
 // -------------------------------------------------------------------------
 // #pragma GCC push_options
 // #pragma GCC optimize ("O0")
 void 
 __attribute__((optimize("O0"))) 
-pe46120_setup_channel(uint8_t phase, uint8_t attenuation, uint8_t channel)
+pe46120_send_word(uint16_t word)
 {
-    // Setup the 14-bit serial word
-    uint16_t word = 0;
-    uint16_t x = 0;
-    x = phase & 0x1f;
-    word |= (x << 2);
-    x = attenuation & 0x0f;
-    word |= (x << 7);
-    x = (channel & 0x01);
-    word |= (x << 13);
+    uint16_t x;
 
     // TODO: make Atomic
     {    // Send the serial word
@@ -158,6 +242,20 @@ pe46120_setup_channel(uint8_t phase, uint8_t attenuation, uint8_t channel)
     }
 }
 // #pragma GCC pop_options
+#endif // PE46120_USE_SPI
+
+// A channel word was sent by the last latch
+static bool fl_pe46120Written;
+
+// -------------------------------------------------------------------------
+//  Setup PE46120 chip, one channel
+// -------------------------------------------------------------------------
+void pe46120_setup_channel(uint8_t phase, uint8_t attenuation, uint8_t channel)
+{
+    channel &= 0x01;
+    pe46120_write(channel, pe46120_word(phase, attenuation, channel));
+}
+
 // -------------------------------------------------------------------------
 //  Setup PE46120 chip, both channels
 // -------------------------------------------------------------------------
@@ -172,118 +270,122 @@ void pe46120_setup(uint8_t phase1, uint8_t phase2, uint8_t attenuation2)
 // -------------------------------------------------------------------------
 void ant_driver_init()
 {
-    RFCLK_AsOutput();
     RFLE_AsOutput();
-    RFSDI_AsOutput();
     RFSDO_AsInput();
-
     RFLE_High();
+
+#ifdef PE46120_USE_SPI
+    RFCLK_AsInput();
+    RFSDI_AsInput();
+    spiBusInit(PE46120_SPI_BUS, SPI_MODE_MASTER);
+#else
+    RFCLK_AsOutput();
+    RFSDI_AsOutput();
     RFCLK_Low();
     RFSDI_Low();
+#endif
 
     //Send initial config
     pe46120_setup(0, 0, 0);
 
+    // Settle time of the last calibration
+    ant_test_set_settle(checkpoint_settle_load(ant_driver_name));
 }
 
 
 // -------------------------------------------------------------------------
 // -------------------------------------------------------------------------
-bool ant_test_sanity_check(test_config_t *newTest)
+bool ant_test_sanity_check(const test_config_t *newTest)
 {    
-    return true;
+    return newTest->ant_encoding <= PHASERTX_ENC_DUAL;
 }
 
 
-// -------------------------------------------------------------------------
-// Setup the test run (Antena parameters)
-// -------------------------------------------------------------------------
-void ant_test_init(test_loop_t *testIdx, test_config_t *test_config, phaser_ping_t *ant_cfg_p)
-{
-    // Init the iterators
-    testIdx->phaseA.idx = 0;
-    testIdx->phaseA.limit = test_config->ant.phase.count;
-    testIdx->phaseB.idx = 0;
-    testIdx->phaseB.limit = test_config->ant.attenuation.count;
-
-    // Init the antena configuration 
-    ant_cfg_p->ant.phase = test_config->ant.phase.start;
-    ant_cfg_p->ant.attenuation = test_config->ant.attenuation.start;
-}
+// Sweep dimensions and antenna state: ant_linear.c
 
 
 // -------------------------------------------------------------------------
-// Setup the test run
-// Return true when next iteration is ready
-// Return false when done (no more iterations possible)
+// Phase encoding of the following states, PHASERTX_ENC_*
 // -------------------------------------------------------------------------
-bool ant_test_next_config(test_loop_t *testIdx, test_config_t *test_config, phaser_ping_t *ant_cfg_p)
+static uint8_t antEncoding = PHASERTX_ENC_NIBBLE;
+
+void ant_test_config(const test_config_t *cfg)
 {
-    // Next phase
-    if(test_config->ant.phase.count){
-        testIdx->phaseA.idx++;
-        if( testIdx->phaseA.idx >= testIdx->phaseA.limit ){
-            testIdx->phaseA.idx = 0;
-            ant_cfg_p->ant.phase = test_config->ant.phase.start;
-        }
-        else {
-            ant_cfg_p->ant.phase += test_config->ant.phase.step;
-            return true;
-        }
-    } 
-    if(test_config->ant.attenuation.count){
-        testIdx->phaseB.idx++;
-        if( testIdx->phaseB.idx >= testIdx->phaseB.limit ){
-            testIdx->phaseB.idx = 0;
-            ant_cfg_p->ant.attenuation = test_config->ant.attenuation.start;
-        }
-        else {
-            ant_cfg_p->ant.attenuation += test_config->ant.attenuation.step;
-            return true;
-        }
-    }
-    return false;
+    antEncoding = cfg->ant_encoding;
 }
 
 
 // -------------------------------------------------------------------------
+// Staged serial words for both channels
 // -------------------------------------------------------------------------
-void ant_test_setup(phaser_ping_t *ant_cfg_p)
+static uint16_t pe46120Staged[2];
+
+void ant_test_stage(ant_state_t *ant)
 {
-    // Build the config for the chip. Send over the serial port to the chip
-    uint8_t p1, p2;
+    // Build the config for the chip.
+    uint8_t p1, p2, att2;
 
     //------ phase encoding by the configuration: -----
+    switch( antEncoding ){
+    case PHASERTX_ENC_CONT:
+        // Use p1 for -90 or ~0=(-2.8) deg only. 
+        // Thus the configuration phase may be used as a continious 6-bit number 
+        // for phase range between ~0 - ~180 deg (2.8 - 177.2 deg to be exact).
+        p1 = ((ant->phase >> 5) & 0x01);  
+        p1 = ( p1==0 ) ? 0x10 : 0x00;
+        p2 = (ant->phase & 0x1f);
+        att2 = ant->attenuation;
+        break;
+
+    case PHASERTX_ENC_DUAL:
+        // Both channel phases, full 5-bit resolution
+        p1 = ant->phase;
+        p2 = ant->attenuation;
+        att2 = 0;
+        break;
+
+    default:
+        // Half byte for each phase.
+        // Note, we loose LSB for each phase. Less resolution but wider range.
+        p1 = ((ant->phase >> 4) & 0x0f) << 1;
+        p2 = (ant->phase & 0x0f) << 1;
+        att2 = ant->attenuation;
+        break;
+    }
 
-    // Version 3
-    // Half byte for each phase
-
-    p1 = ((ant_cfg_p->ant.phase >> 4) & 0x0f);  
-    p2 = (ant_cfg_p->ant.phase & 0x0f);
-    p1 = p1 << 1;
-    p2 = p2 << 1;
-
-    
-    // Version 2
-    // Use p1 for -90 or ~0=(-2.8) deg only. 
-    // Thus the configuration phase may be used as a continious 6-bit number 
-    // for phase range between ~0 - ~180 deg (2.8 - 177.2 deg to be exact).
-
-    // p1 = ((ant_cfg_p->ant.phase >> 5) & 0x01);  
-    // p1 = ( p1==0 ) ? 0x10 : 0x00;
-    // p2 = (ant_cfg_p->ant.phase & 0x1f);
-
+    pe46120Staged[0] = pe46120_word(p1, 0, 0);
+    pe46120Staged[1] = pe46120_word(p2, att2, 1);
+}
 
-    // Version 1 of phase encoding by the configuration.
-    // Note, we loose LSB for each phase. Less resolution but wider range.
+void ant_test_latch()
+{
+    // Send over the serial port to the chip, the changed channels only
+    fl_pe46120Written = pe46120_write(0, pe46120Staged[0]);
+    fl_pe46120Written |= pe46120_write(1, pe46120Staged[1]);
+}
 
-    // p1 = ((ant_cfg_p->ant.phase >> 4) & 0x0f) << 1;
-    // p2 = (ant_cfg_p->ant.phase & 0x0f) << 1;
+// Settle time, us. Set by the calibration.
+#define PE46120_SETTLE_US  1000
+static uint16_t antSettleUs = PE46120_SETTLE_US;
 
+void ant_test_settle()
+{
+    if( !fl_pe46120Written ) return;    // Nothing changed
+    if( antSettleUs ) udelay(antSettleUs);
+}
 
-    pe46120_setup( p1, p2, ant_cfg_p->ant.attenuation);
+void ant_test_set_settle(uint16_t us)
+{
+    antSettleUs = (us == ANT_SETTLE_DEFAULT) ? PE46120_SETTLE_US : us;
+}
 
-    mdelay(1);
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+void ant_test_setup(phaser_ping_t *ant_cfg_p)
+{
+    ant_test_stage(&ant_cfg_p->ant);
+    ant_test_latch();
+    ant_test_settle();
 }
 
 
@@ -10,15 +10,26 @@
 #include "../phaser_msg.h"
 
 #include "antenna_driver.h"
+#include "checkpoint.h"
 
+// Port of the parasitic element pins, for the single write of a state
+// change. santa_hw.h may define them; the defaults below must match the
+// pins SantaPinSetCfg() drives there: element i on bit SANTA_PIN_BIT(i).
+#ifndef SANTA_PIN_PORT_OUT
+#define SANTA_PIN_PORT_OUT  P2OUT
+#endif
+#ifndef SANTA_PIN_BIT
+#define SANTA_PIN_BIT(i)    (1 << (i))
+#endif
 
 // -------------------------------------------------------------------------
 // Driver name and ID
 // -------------------------------------------------------------------------
 char *ant_driver_name = "Santa";
+const bool ant_state_linear = false;
 #define PLATFORM_ID  PH_SANTA
 
-uint8_t santa_pins_list[] = 
+const uint8_t santa_pins_list[] = 
 {
     0b00000000,
     0b00001001,
@@ -57,10 +68,38 @@ uint8_t santa_pins_list[] =
 
 #define santa_pins_list_size (sizeof(santa_pins_list)/sizeof(santa_pins_list[0]))
 
+// Parasitic elements, one pin each
+#define SANTA_PIN_COUNT 6
+#define SANTA_STATE_COUNT (1 << SANTA_PIN_COUNT)
+
+// Settle time after a pin change, us, until the first calibration: the
+// 1 ms of the original driver. The SWEEP_MODE_SETTLE entry of testSet[]
+// measures it, and the checkpoint flash keeps it across the reboots.
+#define SANTA_SETTLE_US 1000
+
+// Port bits of each of the SANTA_STATE_COUNT states, filled at init
+static uint8_t santaPortMask[SANTA_STATE_COUNT];
+static uint8_t santaPortPins;       // All the element bits
+
 // -------------------------------------------------------------------------
 // Set of test configurations that should be executed
 // -------------------------------------------------------------------------
-test_config_t testSet[] = {
+const test_config_t testSet[] = {
+    {
+        .platform_id = PLATFORM_ID,     // Settle time calibration, first
+        .start_delay = 1000,
+        .send_delay  = 10,
+        .send_count  = 50,
+        .angle_step  = 0,
+        .angle_count = 1,
+        .ant.santa_pins.start = 0,      // Extreme states: none and all pins
+        .ant.santa_pins.step = SANTA_STATE_COUNT - 1,
+        .ant.santa_pins.count = 2,
+        .ant.santa_extra  = 0,
+        .sweep_mode = SWEEP_MODE_SETTLE,
+        .settle_tol = 2,                // 0.5 dB
+        .power = {31, 0}
+    },
     {
         .platform_id = PLATFORM_ID,     // Short test
         .start_delay = 1000,
@@ -101,6 +140,20 @@ test_config_t testSet[] = {
         .ant.santa_extra  = 0,
         .power = {31, 0}
     },
+    {
+        .platform_id = PLATFORM_ID,     // All 2^6 states, one pin change per step
+        .start_delay = 1000,
+        .send_delay  = 5,
+        .send_count  = 100,
+        .angle_step  = 5,
+        .angle_count = 40,
+        .ant.santa_pins.start = 0,
+        .ant.santa_pins.step = 1,
+        .ant.santa_pins.count = SANTA_STATE_COUNT,
+        .ant.santa_extra  = 0,
+        .ant_order = SWEEP_ORDER_GRAY,
+        .power = {31, 0}
+    },
 };
 const size_t testSet_size = sizeof(testSet)/sizeof(testSet[0]);
 
@@ -108,72 +161,108 @@ const size_t testSet_size = sizeof(testSet)/sizeof(testSet[0]);
 // -------------------------------------------------------------------------
 void ant_driver_init()
 {
+    uint8_t state, i;
+
+    for(state=0; state<SANTA_STATE_COUNT; state++){
+        santaPortMask[state] = 0;
+        for(i=0; i<SANTA_PIN_COUNT; i++){
+            if( state & (1 << i) ) santaPortMask[state] |= SANTA_PIN_BIT(i);
+        }
+    }
+    santaPortPins = santaPortMask[SANTA_STATE_COUNT - 1];
+
     SantaPinInit();
     SantaPinSetCfg(0);
+    // Settle time of the last calibration
+    ant_test_set_settle(checkpoint_settle_load(ant_driver_name));
 }
 
 
 // -------------------------------------------------------------------------
 // -------------------------------------------------------------------------
-bool ant_test_sanity_check(test_config_t *newTest)
+bool ant_test_sanity_check(const test_config_t *newTest)
 {    
     return true;
 }
 
 
 // -------------------------------------------------------------------------
-// Setup the test run (Antena parameters)
 // -------------------------------------------------------------------------
-void ant_test_init(test_loop_t *testIdx, test_config_t *test_config, phaser_ping_t *ant_cfg_p)
+void ant_test_config(const test_config_t *cfg)
 {
-    // Init the iterators
-    testIdx->phaseA.idx = 0;
-    testIdx->phaseA.limit = test_config->ant.santa_pins.count;
-    testIdx->phaseB.idx = 0;
-    testIdx->phaseB.limit = 0;
-
-    // Init the antena configuration 
-    ant_cfg_p->ant.santa_pins = test_config->ant.santa_pins.start;
-    ant_cfg_p->ant.santa_extra = 0;
 }
 
 
 // -------------------------------------------------------------------------
-// Setup the test run
-// Return true when next iteration is ready
-// Return false when done (no more iterations possible)
+// Sweep dimensions of the antenna configuration
 // -------------------------------------------------------------------------
-bool ant_test_next_config(test_loop_t *testIdx, test_config_t *test_config, phaser_ping_t *ant_cfg_p)
+void ant_test_dims(const test_config_t *cfg, uint16_t *countA, uint16_t *countB)
 {
-    // Next phase
-    if(test_config->ant.santa_pins.count){
-        testIdx->phaseA.idx++;
-        if( testIdx->phaseA.idx >= testIdx->phaseA.limit ){
-            testIdx->phaseA.idx = 0;
-            ant_cfg_p->ant.santa_pins = test_config->ant.santa_pins.start;
-        }
-        else {
-            // Calculate the next config for the antenna
-            // For small config count use preset configs, for large just increment
-            if(test_config->ant.santa_pins.count > santa_pins_list_size){
-                ant_cfg_p->ant.santa_pins += test_config->ant.santa_pins.step;
-            }
-            else {
-                ant_cfg_p->ant.santa_pins = santa_pins_list[testIdx->phaseA.idx];
-            }
-            return true;
-        }
+    *countA = cfg->ant.santa_pins.count;
+    *countB = 0;
+}
+
+
+// -------------------------------------------------------------------------
+// Antenna state for the value positions in the sweep dimensions
+// -------------------------------------------------------------------------
+void ant_test_state(const test_config_t *cfg, uint16_t kA, uint16_t kB, ant_state_t *ant)
+{
+    // One element: the pin state
+    ANT_STATE_CLEAR(ant, ANT_FORMAT(1, 8));
+
+    // For small config count use preset configs, for large just increment.
+    // Other steps than 1 (the settle calibration) are the plain range.
+    if( kA == 0 || cfg->ant.santa_pins.count > santa_pins_list_size
+            || cfg->ant.santa_pins.step != 1 ){
+        ant->santa_pins = cfg->ant.santa_pins.start + kA * cfg->ant.santa_pins.step;
+    }
+    else {
+        ant->santa_pins = santa_pins_list[kA];
     }
-    return false;
 }
 
 
+// -------------------------------------------------------------------------
+// Staged antenna state
+// -------------------------------------------------------------------------
+static uint8_t santaPortStaged;
+
+void ant_test_stage(ant_state_t *ant)
+{
+    santaPortStaged = santaPortMask[ant->santa_pins & (SANTA_STATE_COUNT - 1)];
+}
+
+// All the elements change in one port write, the other bits are kept
+void ant_test_latch()
+{
+    Handle_t h;
+
+    ATOMIC_START(h);
+    SANTA_PIN_PORT_OUT = (SANTA_PIN_PORT_OUT & ~santaPortPins) | santaPortStaged;
+    ATOMIC_END(h);
+}
+
+static uint16_t antSettleUs = SANTA_SETTLE_US;
+
+void ant_test_settle()
+{
+    // Wait a bit for the config to settle
+    if( antSettleUs ) udelay(antSettleUs);
+}
+
+void ant_test_set_settle(uint16_t us)
+{
+    antSettleUs = (us == ANT_SETTLE_DEFAULT) ? SANTA_SETTLE_US : us;
+}
+
 // -------------------------------------------------------------------------
 // -------------------------------------------------------------------------
 void ant_test_setup(phaser_ping_t *ant_cfg_p)
 {
-    SantaPinSetCfg(ant_cfg_p->ant.santa_pins);
-    mdelay(1);  // Wait a bit for the config to settle
+    ant_test_stage(&ant_cfg_p->ant);
+    ant_test_latch();
+    ant_test_settle();
 }
 
 
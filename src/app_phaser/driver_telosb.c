@@ -18,13 +18,14 @@ PIN_DEFINE(TmoteBtn, 2, 7);
 // Driver name and ID
 // -------------------------------------------------------------------------
 char *ant_driver_name = "TelosB";
+const bool ant_state_linear = false;
 #define PLATFORM_ID  PH_TELOSB
 
 
 // -------------------------------------------------------------------------
 // Set of test configurations that should be executed
 // -------------------------------------------------------------------------
-test_config_t testSet[] = {
+const test_config_t testSet[] = {
     {
         .platform_id = PLATFORM_ID,     // Short test
         .start_delay = 1000,
@@ -63,32 +64,37 @@ void ant_driver_init()
 
 // -------------------------------------------------------------------------
 // -------------------------------------------------------------------------
-bool ant_test_sanity_check(test_config_t *newTest)
+bool ant_test_sanity_check(const test_config_t *newTest)
 {    
     return true;
 }
 
 
 // -------------------------------------------------------------------------
-// Setup the test run (Antena parameters)
 // -------------------------------------------------------------------------
-void ant_test_init(test_loop_t *testIdx, test_config_t *test_config, phaser_ping_t *ant_cfg_p)
+void ant_test_config(const test_config_t *cfg)
 {
-    //Nothing to do
-    return;
 }
 
 
+// -------------------------------------------------------------------------
+// Sweep dimensions of the antenna configuration
+// -------------------------------------------------------------------------
+void ant_test_dims(const test_config_t *cfg, uint16_t *countA, uint16_t *countB)
+{
+    //Nothing to sweep
+    *countA = 0;
+    *countB = 0;
+}
+
 
 // -------------------------------------------------------------------------
-// Setup the test run
-// Return true when next iteration is ready
-// Return false when done (no more iterations possible)
+// Antenna state for the value positions in the sweep dimensions
 // -------------------------------------------------------------------------
-bool ant_test_next_config(test_loop_t *testIdx, test_config_t *test_config, phaser_ping_t *ant_cfg_p)
+void ant_test_state(const test_config_t *cfg, uint16_t kA, uint16_t kB, ant_state_t *ant)
 {
     //Nothing to do
-    return false;
+    ANT_STATE_CLEAR(ant, ANT_FORMAT(1, 8));
 }
 
 
@@ -100,6 +106,26 @@ void ant_test_setup(phaser_ping_t *ant_cfg_p)
     return;
 }
 
+void ant_test_stage(ant_state_t *ant)
+{
+    //Nothing to do
+}
+
+void ant_test_latch()
+{
+    //Nothing to do
+}
+
+void ant_test_settle()
+{
+    //Nothing to do
+}
+
+void ant_test_set_settle(uint16_t us)
+{
+    //Nothing to do
+}
+
 // -------------------------------------------------------------------------
 // -------------------------------------------------------------------------
 void ledBtnDown()
@@ -8,6 +8,16 @@
 #include "../phaser_msg.h"
 #include "../msg_framework.h"
 #include "antenna_driver.h"
+#include "campaign.h"
+#include "schedule.h"
+#include "search.h"
+#include "track.h"
+#include "settle.h"
+#include "rto.h"
+#include "checkpoint.h"
+#include "shard.h"
+#include "tlv.h"
+#include "trace.h"
 
 // #define PH_COMMENT ""
 
@@ -17,6 +27,56 @@
 // Comment to disable debug messages over serial port
 #define FL_TEST_RESTART_ON_END 1
 
+// Comment to pace the test pings with mdelay() loops instead of the timer
+#define TX_PACING_TIMER 1
+
+// Comment to run the testSet[] entries one by one, each with own angle sweep.
+// Otherwise all the entries are run in one sweep, if the planner finds it cheaper.
+#define CAMPAIGN_MERGED 1
+
+// Uncomment to send the angle messages to a co-located stepper over the
+// wired serial link, instead of the radio. The serial port must not be
+// the PRINTF one, or DEBUG_PHASER must be off.
+// #define STEPPER_WIRED 1
+#define STEPPER_LINK_SERIAL_ID 1
+#define STEPPER_LINK_TIMEOUT_MS 20000   // Longest move, with the recalibration
+
+// Comment to disable the checkpoints of the sweep cursor in flash, ms.
+// Each one wears the info flash, see checkpoint.h.
+#define CHECKPOINT_INTERVAL_MS 300000ul
+
+// Comment to start over after a reset, instead of resuming from the checkpoint
+#define CHECKPOINT_RESUME_AT_BOOT 1
+
+// Phaser node ID, 0 .. PH_NODE_MAX-1, in the pings. Node 0 drives the
+// stepper. Set from the Makefile for a second node: CFLAGS += -DPH_NODE_ID=1
+#ifndef PH_NODE_ID
+#define PH_NODE_ID 0
+#endif
+
+// Uncomment to ping only in the TDMA slot of the node, on the monitor
+// beacon grid (TDMA_BEACON in app_monitor). PH_NODE_ID < PH_TDMA_NODES.
+// All the nodes must visit the same angles.
+// #define TDMA_SLOTTED 1
+
+// Uncomment to send the compact test messages, when the monitor can rebuild
+// the sweep from the config. Padding: CFLAGS += -DPH_PING_PAD=n, both nodes.
+// #define PING_COMPACT 1
+
+// Uncomment to record the timing of the test loop phases, dumped to the
+// monitor on its request. See trace.h.
+// #define TRACE_PHASES 1
+#ifdef TRACE_PHASES
+#define TRACE(phase, arg)   trace_mark(phase, arg)
+#define TRACE_CHUNK_DELAY_MS 200    // The monitor prints each entry
+#else
+#define TRACE(phase, arg)
+#endif
+
+// Uncomment to send the test pings without the clear channel check.
+// The airtime of each ping is then deterministic (no CCA retries).
+// #define TX_MEASURE_NO_CCA 1
+
 #define RADIO_MAX_TX_POWER 31
 #define RADIO_BUF_PAYLOAD_LEN RADIO_MAX_PACKET
 
@@ -27,9 +87,42 @@ test_config_t test_config;
 // Test iterator
 test_loop_t testIdx = TEST_LOOP_INIT_VAL;
 
+// Sweep schedule of the current configuration, and the step in it
+static schedule_t sched;
+static uint32_t schedIdx;
+
+// Sweep dimensions of the current TLV config. dimCount 0: from test_config.
+static sweep_spec_t sweepSpec;
+
+// Beam search at the current angle (SWEEP_MODE_SEARCH)
+static search_t search;
+
+// Beam tracking (SWEEP_MODE_TRACK)
+static track_t track;
+static phaser_result_t lastResult;
+bool fl_ResultRecv=false;
+
+// Settle time calibration (SWEEP_MODE_SETTLE)
+static settle_t settle;
+static ant_state_t settleFrom;      // State switched from before each ping
+static uint16_t settleDelayUs;      // Switch to ping delay being measured
+
+// Reverse link: echoes of the current experiment pings (test_config_t.echo)
+static rssi_data_t echoRssi;
+static lqi_data_t echoLqi;
+
 // Global configuration counter. Each config is defined in the testSet[] array.
 static int config_counter=0;
 
+#ifdef CAMPAIGN_MERGED
+// Merged campaign plan and the position in it
+static campaign_plan_t plan;
+static int planAngleNum;    // Number of the current angle in the sweep
+static int planEntryPos;    // Entry position at the current angle
+static bool fl_planPassDone = false;    // Merged campaign ran to the end
+static bool fl_planDescending = false;  // Angle direction of the pass
+#endif
+
 
 //--- Global data -----------------------------------------------------------
 
@@ -39,11 +132,103 @@ bool fl_test_stop=true;
 
 angle_t lastAngle = ANGLE_NOT_SET_VALUE;
 bool fl_AngleSet=false;
+
+// Monitor reported the current experiment as converged (adaptive mode)
+static volatile bool fl_expConverged=false;
+
+// Control action received over the radio, processed outside the RX handler
+static volatile msg_action_t pendingCtrlAction = MSG_ACT_CLEAR;
+
+// Config received during the test, swapped in by test_next()
+static test_config_t pendingConfig;
+static volatile bool fl_configPending = false;
+static volatile bool fl_configRejected = false;
+static uint8_t configEpoch = 0;     // Configs swapped in since boot
+
+// Config received while no test runs: the next run starts with it
+static volatile bool fl_testRunning = false;
+static volatile bool fl_configStopped = false;
+static bool fl_configRun = false;   // The run is of a received config
+
+// TLV config being received, and its sweep dimensions when pending
+static tlv_rx_t tlvRx;
+static test_config_t tlvConfig;
+static sweep_spec_t pendingSpec;
+static bool fl_configTlv = false;   // Pending config is a TLV one
+static bool fl_configTlvRun = false;    // Running config is a TLV one
+
+#ifdef CAMPAIGN_MERGED
+// Merged campaign: the entry replaced by a swapped config, and the config.
+// Loaded instead of testSet[] until the end of the campaign. One entry at
+// a time, a swap of another entry is rejected.
+static int8_t swapIdx = -1;
+static test_config_t swapConfig;
+static sweep_spec_t swapSpec;
+static bool fl_swapTlv = false;
+#endif
+
+// Sharded campaign, and the assignment received, applied by shard_apply()
+static shard_t shard;
+static phaser_shard_t pendingShard;
+static volatile bool fl_shardPending = false;
+
+// Checkpoint of the sweep cursor, and resume from it on the next start
+#ifdef CHECKPOINT_INTERVAL_MS
+static checkpoint_t checkpoint;
+static bool fl_checkpointValid = false;
+static uint32_t checkpointTime;
+#ifdef CHECKPOINT_RESUME_AT_BOOT
+static volatile bool fl_resume = true;
+#else
+static volatile bool fl_resume = false;
+#endif
+#endif
+
+// Reliable control: sequence number of the last message sent, its ACK
+#define CTRL_RETRY_MAX 6
+static uint8_t ctrlSeq = 0;
+static volatile bool fl_CtrlAcked = false;
+static rto_t ctrlRto;
+
+// Hardware state applied last, for skipping the unchanged setup steps
+static ant_state_t antLatched;
+static bool fl_antLatchedValid = false;   // false: antLatched unknown
+static bool fl_antStaged = false;         // next state staged in the driver
+static int lastTxPower = -1;              // -1: unknown
+static uint8_t radioChannel = PH_CHANNEL_HOME;
+
+// TX pacing timer: Timer B compare 1, clocked from ACLK.
+// The radio IRQ does not wake the CPU, so a long slot wait wakes every
+// TX_SLOT_STEP_TICKS to handle the control messages received meanwhile.
+#ifdef TX_PACING_TIMER
+#define TX_SLOT_TICK_HZ     32768ul
+#define TX_SLOT_STEP_TICKS  (TX_SLOT_TICK_HZ / 50)     // 20 ms
+static uint16_t txSlotTick;     // TBR of the last slot timer compare
+static uint16_t txSlotFrac;     // ms to ticks rounding carried to the next slot
+static volatile bool fl_txSlotTick = false;
+#endif
+
+// TDMA: last monitor beacon, and the time it was received
+#ifdef TDMA_SLOTTED
+static phaser_beacon_t tdmaBeacon;
+static volatile uint32_t tdmaRef;
+static volatile bool fl_tdmaSync = false;       // a beacon received
+static volatile bool fl_tdmaBeacon = false;     // new beacon since cleared
+static uint32_t tdmaLastPing;
+MSG_NEW_WITH_ID(beacon_msg, phaser_beacon_t, PH_MSG_Beacon);
+#endif
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 
 // Define a buffer for receiving messages
 MSG_DEFINE_BUFFER_WITH_ID(radioBuffer, recv_data_p, RADIO_BUF_PAYLOAD_LEN);
 
+#ifdef STEPPER_WIRED
+// Wired stepper link receive buffer
+MSG_DEFINE_BUFFER_WITH_ID(linkBuffer, link_data_p, sizeof(phaser_angle_t));
+static uint8_t linkState = STEPPER_LINK_WAIT_SYNC;
+static uint8_t linkLen, linkPos;
+#endif
+
 // Phaser configuration message
 MSG_NEW_WITH_ID(ant_msg, phaser_ping_t, PH_MSG_Test);
 phaser_ping_t *ant_cfg_p = &(ant_msg.payload);
@@ -60,6 +245,42 @@ MSG_NEW_WITH_ID(config_msg, test_config_t, PH_MSG_Config);
 // Phaser test configuration message
 MSG_NEW_WITH_ID(text_msg, msg_text_data_t, PH_MSG_Text);
 
+// Experiment result request and the search result
+MSG_NEW_WITH_ID(result_msg, phaser_result_t, PH_MSG_Result);
+
+// Test session setup
+MSG_NEW_WITH_ID(session_msg, phaser_session_t, PH_MSG_Session);
+
+// Reply to a config received during the test
+MSG_NEW_WITH_ID(config_ack_msg, phaser_config_ack_t, PH_MSG_ConfigAck);
+
+// Continuous wave sweep announcement
+MSG_NEW_WITH_ID(cw_msg, phaser_cw_t, PH_MSG_Cw);
+
+// Reverse link summary of an experiment
+MSG_NEW_WITH_ID(echo_result_msg, phaser_echo_result_t, PH_MSG_EchoResult);
+
+// Channel hop
+MSG_NEW_WITH_ID(channel_msg, phaser_channel_t, PH_MSG_Channel);
+
+// Reply to the shard assignment
+MSG_NEW_WITH_ID(shard_msg, phaser_shard_t, PH_MSG_Shard);
+
+#ifdef TRACE_PHASES
+// Timing trace dump, and its request
+MSG_NEW_WITH_ID(trace_msg, phaser_trace_t, PH_MSG_Trace);
+static volatile bool fl_traceDump = false;
+#endif
+
+#ifdef PING_COMPACT
+// Compact test message, and the sweep position it is rebuilt from
+MSG_NEW_WITH_ID(compact_msg, phaser_ping_compact_t, PH_MSG_TestCompact);
+MSG_NEW_WITH_ID(anchor_msg, phaser_anchor_t, PH_MSG_Anchor);
+static uint8_t pingEpoch = 0;
+static bool fl_anchorPending = false;   // Send the anchor before the pings
+static bool fl_pingCompact = false;     // The monitor has the anchor
+#endif
+
 
 // -------------------------------------------------------------------------
 // Delay in ms, using a variable instead of constant.
@@ -73,13 +294,115 @@ void mdelay_var(int ms)
 }
 
 
+// -------------------------------------------------------------------------
+// Set the radio TX power, only if it changed.
+// -------------------------------------------------------------------------
+void radio_set_power(int power)
+{
+    if( power == lastTxPower ) return;
+    radioSetTxPower(power);
+    lastTxPower = power;
+}
+
+// -------------------------------------------------------------------------
+// Measurement TX without the clear channel assessment.
+// CCA threshold at max makes the channel always clear for the radio.
+// The register is read before the change and restored as it was.
+// -------------------------------------------------------------------------
+#ifdef TX_MEASURE_NO_CCA
+#define CC2420_RSSI_CCA_THR_MASK    0xFF00  // CCA_THR, the high byte
+#define CC2420_RSSI_CCA_THR_OFF     0x7F00  // CCA_THR=+127
+
+void tx_measure_cca(bool on)
+{
+    static uint16_t rssiSaved;
+    static bool fl_ccaOff = false;
+
+    if( on ){
+        if( fl_ccaOff ) CC2420_WRITE_REG(CC2420_RSSI, rssiSaved);
+        fl_ccaOff = false;
+        return;
+    }
+    if( fl_ccaOff ) return;
+    CC2420_READ_REG(CC2420_RSSI, rssiSaved);
+    CC2420_WRITE_REG(CC2420_RSSI,
+        (rssiSaved & ~CC2420_RSSI_CCA_THR_MASK) | CC2420_RSSI_CCA_THR_OFF);
+    fl_ccaOff = true;
+}
+#else
+#define tx_measure_cca(on)
+#endif
+
+// -------------------------------------------------------------------------
+// Unmodulated carrier, CC2420 test mode (datasheet: MDMCTRL1.TX_MODE=2,
+// DACTST=0x1800, STXON). The radio is back in RX when off.
+// -------------------------------------------------------------------------
+#define CC2420_MDMCTRL1_TX_MODE_MASK    0x000C
+#define CC2420_MDMCTRL1_TX_MODE_CW      0x0008
+#define CC2420_DACTST_CW                0x1800
+
+void radio_cw(bool on)
+{
+    static uint16_t mdmctrl1;
+
+    if( on ){
+        CC2420_READ_REG(CC2420_MDMCTRL1, mdmctrl1);
+        CC2420_WRITE_REG(CC2420_MDMCTRL1,
+            (mdmctrl1 & ~CC2420_MDMCTRL1_TX_MODE_MASK) | CC2420_MDMCTRL1_TX_MODE_CW);
+        CC2420_WRITE_REG(CC2420_DACTST, CC2420_DACTST_CW);
+        CC2420_STROBE(CC2420_STXON);
+    }
+    else {
+        CC2420_STROBE(CC2420_SRFOFF);
+        CC2420_WRITE_REG(CC2420_DACTST, 0);
+        CC2420_WRITE_REG(CC2420_MDMCTRL1, mdmctrl1);
+        CC2420_STROBE(CC2420_SRXON);
+    }
+}
+
+// -------------------------------------------------------------------------
+// Wait until the last packet has left the radio.
+// Called before control messages, so it also restores the CCA.
+// -------------------------------------------------------------------------
+void tx_drain()
+{
+    while( cc2420IsTxBusy() );
+    tx_measure_cca(true);
+}
+
 // -------------------------------------------------------------------------
 // Setup the test run parameters
 // -------------------------------------------------------------------------
 void config_init()
 {
+    Handle_t h;
+
     config_counter=0;   // Restart from the first stored configuration
-    memcpy(&test_config, &(testSet[0]), sizeof(test_config_t));
+
+    // A config pending at the end of the last run is of that run
+    ATOMIC_START(h);
+    fl_configRun = fl_configStopped;
+    if( fl_configRun ) memcpy(&test_config, &pendingConfig, sizeof(test_config_t));
+    else memcpy(&test_config, &(testSet[0]), sizeof(test_config_t));
+    fl_configStopped = false;
+    fl_configPending = false;
+    fl_configTlv = false;
+    ATOMIC_END(h);
+    sweepSpec.dimCount = 0;
+    fl_configTlvRun = false;
+
+#ifdef CAMPAIGN_MERGED
+    swapIdx = -1;
+    campaign_plan(&plan, testSet, testSet_size);
+    // The shards are of the sequential campaign, a received config
+    // is run first, as testSet[0] is
+    if( shard.active || fl_configRun ) plan.merged = false;
+#ifdef DEBUG_PHASER
+    PRINTF("Plan: merged=%d serpentine=%d cost=%ld/%ld ms\n",
+        (int)plan.merged, (int)plan.serpentine,
+        (long)plan.costMerged, (long)plan.costSequential);
+#endif
+#endif
 }
 
 
@@ -91,16 +414,41 @@ void send_test_config()
 }
 
 // -------------------------------------------------------------------------
-// Set up new configuration.
-// Return "true" on success.
+// Check the configuration.
+// Return "true" if it can be run. spec: sweep dimensions of a TLV config,
+// or NULL.
 // -------------------------------------------------------------------------
-bool config_new(test_config_t *newTest)
+bool config_check(const test_config_t *newTest, const sweep_spec_t *spec)
 {
     int i;
 
     // Check test sanity
     if(newTest->start_delay > 20000) return false;
     if(newTest->send_delay > 10000) return false;
+    if(newTest->send_count_min > newTest->send_count) return false;
+    if(newTest->sweep_mode == SWEEP_MODE_SEARCH && newTest->search_coarse == 0) return false;
+
+    if(newTest->sweep_mode == SWEEP_MODE_CW){
+        schedule_t s;
+        schedule_init(&s, newTest, spec);
+        if(s.count > CW_SLOT_MAX) return false;
+        if(newTest->send_delay < CW_SLOT_MS_MIN || newTest->send_delay > 0xff) return false;
+        if(newTest->send_count == 0 || newTest->send_count > 0xff) return false;
+        if(newTest->echo) return false;
+    }
+    // The echo must be back before the next ping
+    if(newTest->echo && newTest->send_delay < ECHO_WAIT_MS) return false;
+
+    if(newTest->channel.count > 0){
+#ifdef TDMA_SLOTTED
+        // The monitor can follow the hops of one node only
+        return false;
+#endif
+        if(newTest->channel.count > 1 && newTest->sweep_mode != SWEEP_MODE_FULL) return false;
+        if(newTest->channel.start < PH_CHANNEL_MIN) return false;
+        if(newTest->channel.start + (uint32_t)newTest->channel.step * (newTest->channel.count - 1)
+            > PH_CHANNEL_MAX) return false;
+    }
 
     for(i=0; i<TEST_CONFIG_POWER_LIST_SIZE; i++){
         if( newTest->power[i] > RADIO_MAX_TX_POWER ) return false;
@@ -110,7 +458,51 @@ bool config_new(test_config_t *newTest)
         return false;
     }
 
+    if( spec && spec->dimCount ){
+        // The other modes walk the antenna dimensions themselves
+        if(newTest->sweep_mode != SWEEP_MODE_FULL && newTest->sweep_mode != SWEEP_MODE_CW) return false;
+        if( !schedule_check(newTest, spec) ) return false;
+        for(i=0; i<spec->dimCount; i++){
+            // CW slots have a fixed length
+            if(newTest->sweep_mode == SWEEP_MODE_CW && spec->dim[i].kind == SWEEP_DIM_DWELL) return false;
+#ifdef TDMA_SLOTTED
+            if(spec->dim[i].kind == SWEEP_DIM_CHANNEL) return false;
+#endif
+        }
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// May the config received during the test replace the running entry.
+// A new config is rejected while another one waits for the swap.
+// -------------------------------------------------------------------------
+bool config_swap_allowed(const test_config_t *newTest)
+{
+    if( shard.active || fl_configPending ) return false;
+#ifdef CAMPAIGN_MERGED
+    if( plan.merged ){
+        // The plan visits the angles of the testSet[] entry
+        const test_config_t *entry = &(testSet[ant_cfg_p->configIdx]);
+        if( newTest->angle_step != entry->angle_step ) return false;
+        if( newTest->angle_count != entry->angle_count ) return false;
+        if( swapIdx >= 0 && swapIdx != ant_cfg_p->configIdx ) return false;
+    }
+#endif
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// Set up new configuration.
+// Return "true" on success.
+// -------------------------------------------------------------------------
+bool config_new(const test_config_t *newTest)
+{
+    if( !config_check(newTest, NULL) ) return false;
+
     memcpy(&test_config, newTest, sizeof(test_config));
+    sweepSpec.dimCount = 0;
+    fl_configTlvRun = false;
 
     // Send the received config back, for verification.
     // send_test_config();
@@ -127,23 +519,140 @@ void reportStatus()
     send_test_config();
 }
 
+// -------------------------------------------------------------------------
+// Reliable control.
+// The message is sent again after the adaptive timeout, until ACKed or
+// CTRL_RETRY_MAX sends. One round trip when the link is good.
+// -------------------------------------------------------------------------
+#define CTRL_SEND_RELIABLE(msg, flAcked) do{        \
+    int _try;                                       \
+    tx_drain();                                     \
+    radio_set_power(RADIO_MAX_TX_POWER);            \
+    flAcked = false;                                \
+    for(_try=0; _try<CTRL_RETRY_MAX && !flAcked; _try++){  \
+        uint32_t _sent = getTimeMs();               \
+        fl_CtrlAcked = false;                       \
+        MSG_RADIO_SEND( msg );                      \
+        flAcked = ctrl_wait_ack(_sent, _try==0);    \
+    }                                               \
+}while(0)
+
+// Sequence number for the next message, 0 is not used
+// The node ID is in the top bits.
+uint8_t ctrl_next_seq()
+{
+    static uint8_t n = 0;
+    if( ++n >= (1 << PH_CTRL_SEQ_NODE_SHIFT) ) n = 1;
+    ctrlSeq = (PH_NODE_ID << PH_CTRL_SEQ_NODE_SHIFT) | n;
+    return ctrlSeq;
+}
+
+// Wait for the ACK of ctrlSeq, sent at time sent. Update the timeout.
+// Sleeps in low power mode between the checks, the ACK is seen at most
+// CTRL_ACK_POLL_MS after the radio IRQ. Pending control work is not
+// processed here, its replies are sent with this macro too.
+#define CTRL_ACK_POLL_MS    1
+bool ctrl_wait_ack(uint32_t sent, bool flFirst)
+{
+    uint32_t rtt;
+
+    while( !fl_CtrlAcked ){
+        rtt = getTimeMs() - sent;
+        if( rtt >= ctrlRto.rto ){
+            rto_backoff(&ctrlRto);
+            return false;
+        }
+        msleep(CTRL_ACK_POLL_MS);
+    }
+    // Retransmitted messages give ambiguous round trip times
+    if( flFirst ) rto_sample(&ctrlRto, getTimeMs() - sent);
+    return true;
+}
+
 // -------------------------------------------------------------------------
 // Send control message about the test.
+// Return true when ACKed.
 // -------------------------------------------------------------------------
-void send_ctrl_msg(msg_action_t act)
+bool send_ctrl_msg(msg_action_t act)
 {
-    int i;
+    bool flAcked;
+
     ctrl_msg.payload.action = act;
+    ctrl_msg.payload.seq = ctrl_next_seq();
     MSG_DO_CHECKSUM( ctrl_msg );
 
-    // Send 3 times for reliability.
-    radioSetTxPower(RADIO_MAX_TX_POWER);
-    mdelay(20);
-    for(i=0; i<3; i++){
-        MSG_RADIO_SEND( ctrl_msg );
-        mdelay(100);
-    }
+    CTRL_SEND_RELIABLE( ctrl_msg, flAcked );
+
+#ifdef DEBUG_PHASER
+    if( !flAcked ) PRINTF("Ctrl %d: no ACK\n", (int)act);
+#endif
+    return flAcked;
+}
+
+// -------------------------------------------------------------------------
+// Hop to the radio channel, together with the monitor.
+// Without the ACK the monitor may have hopped anyway, the phaser hops too.
+// -------------------------------------------------------------------------
+void channel_set(uint8_t channel)
+{
+    bool flAcked;
+
+    if( channel == radioChannel ) return;
+
+    channel_msg.payload.action = MSG_ACT_SET;
+    channel_msg.payload.seq = ctrl_next_seq();
+    channel_msg.payload.channel = channel;
+    channel_msg.payload.expIdx = ant_cfg_p->expIdx;
+    MSG_DO_CHECKSUM( channel_msg );
+
+    CTRL_SEND_RELIABLE( channel_msg, flAcked );
+
+    radioSetChannel(channel);
+    radioChannel = channel;
+
+#ifdef DEBUG_PHASER
+    if( !flAcked ) PRINTF("Channel %d: no ACK\n", (int)channel);
+#endif
+}
+
+// -------------------------------------------------------------------------
+// Compact pings: send the sweep position of the pings that follow.
+// Sent at each angle and config, the monitor may have missed one.
+// Full pings when the monitor can not rebuild the sweep, or no ACK.
+// -------------------------------------------------------------------------
+#ifdef PING_COMPACT
+void ping_anchor()
+{
+    phaser_anchor_t *a = &(anchor_msg.payload);
+    bool flAcked;
+
+    fl_anchorPending = false;
+    fl_pingCompact = false;
+    if( !ant_state_linear || test_config.sweep_mode != SWEEP_MODE_FULL ) return;
+    // The monitor does not parse the TLV records
+    if( fl_configTlvRun || sched.count > 0xffff ) return;
+
+    pingEpoch = (pingEpoch + 1) & PH_EPOCH_MASK;
+    a->action = MSG_ACT_SET;
+    a->seq = ctrl_next_seq();
+    a->epoch = (PH_NODE_ID << PH_CTRL_SEQ_NODE_SHIFT) | pingEpoch;
+    a->configIdx = ant_cfg_p->configIdx;
+    a->expIdx = ant_cfg_p->expIdx;
+    a->angle = ant_cfg_p->angle;
+    a->step = schedIdx;
+    a->nodeId = PH_NODE_ID;
+    MSG_DO_CHECKSUM( anchor_msg );
+
+    CTRL_SEND_RELIABLE( anchor_msg, flAcked );
+
+    compact_msg.payload.epoch = a->epoch;
+    fl_pingCompact = flAcked;
+
+#ifdef DEBUG_PHASER
+    if( !flAcked ) PRINTF("Anchor: no ACK, full pings\n");
+#endif
 }
+#endif
 
 // -------------------------------------------------------------------------
 // -------------------------------------------------------------------------
@@ -153,27 +662,71 @@ void send_string(char *str)
     if(len>0 && len<MSG_TEXT_SIZE_MAX-1){
         memcpy(text_msg.payload.text, str, len);
 
-        radioSetTxPower(RADIO_MAX_TX_POWER);
+        tx_drain();
+        radio_set_power(RADIO_MAX_TX_POWER);
         MSG_RADIO_SEND( text_msg );
     }
 }
 
 
 // -------------------------------------------------------------------------
+// Send the session setup with the config: driver name, comment and config
+// in one message. Return true when ACKed.
 // -------------------------------------------------------------------------
-void test_start()
+bool send_session(const test_config_t *cfg, msg_action_t act, uint8_t configCount)
 {
-    send_string(ant_driver_name);
+    bool flAcked;
+    phaser_session_t *s = &(session_msg.payload);
 
+    s->action = act;
+    s->seq = ctrl_next_seq();
+    s->configCount = configCount;
+
+    memset(s->name, 0, PH_SESSION_NAME_LEN);
+    strncpy(s->name, ant_driver_name, PH_SESSION_NAME_LEN-1);
 #ifdef PH_COMMENT
-    send_string(PH_COMMENT);
+    strncat(s->name, " " PH_COMMENT, PH_SESSION_NAME_LEN-1 - strlen(s->name));
 #endif
+    memcpy(&(s->config), cfg, sizeof(test_config_t));
+    MSG_DO_CHECKSUM( session_msg );
 
-    //Send config for the test to be run
-    send_test_config();
-    mdelay(100);    //give the receiver time to parse the config
+    CTRL_SEND_RELIABLE( session_msg, flAcked );
 
-    send_ctrl_msg(MSG_ACT_START);
+#ifdef DEBUG_PHASER
+    if( !flAcked ) PRINTF("Session: no ACK\n");
+#endif
+    return flAcked;
+}
+
+// -------------------------------------------------------------------------
+// Send all the testSet[] entries of the merged campaign.
+// The last one starts the test.
+// -------------------------------------------------------------------------
+#ifdef CAMPAIGN_MERGED
+void send_campaign_configs()
+{
+    static test_config_t cfg;
+    size_t i;
+    for(i=0; i<testSet_size; i++){
+        memcpy(&cfg, &(testSet[i]), sizeof(test_config_t));
+        cfg.config_idx = i;
+        send_session(&cfg, (i+1 < testSet_size) ? MSG_ACT_SET : MSG_ACT_START, testSet_size);
+    }
+}
+#endif
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+void test_start()
+{
+    //Send config for the test to be run, and start it
+#ifdef CAMPAIGN_MERGED
+    if( plan.merged ){
+        send_campaign_configs();
+    }
+    else
+#endif
+    send_session(&test_config, MSG_ACT_START, 1);
 }
 
 // -------------------------------------------------------------------------
@@ -197,6 +750,7 @@ void onRadioRecv(void)
     flRxProcessing = true;
 
     static int rxLen;
+    static uint16_t tlvLen;
     rxLen = MSG_RADIO_RECV(radioBuffer);
     if (rxLen < 0) {
         // led2Toggle();
@@ -213,6 +767,17 @@ void onRadioRecv(void)
     MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_angle_t, angle_p);
     MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_control_t, control_p);
     MSG_NEW_PAYLOAD_PTR(radioBuffer, test_config_t, test_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_converged_t, converged_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_result_t, result_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_echo_t, echo_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_shard_t, shard_p);
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_tlv_chunk_t, tlv_p);
+#ifdef TRACE_PHASES
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_trace_t, trace_p);
+#endif
+#ifdef TDMA_SLOTTED
+    MSG_NEW_PAYLOAD_PTR(radioBuffer, phaser_beacon_t, beacon_p);
+#endif
 
 
     switch( radioBuffer.id ){
@@ -227,58 +792,622 @@ void onRadioRecv(void)
         switch( control_p->action ){
         case MSG_ACT_RESTART:
             fl_test_restart = true;
-            send_ctrl_msg(MSG_ACT_IDLE);
+            pendingCtrlAction = control_p->action;
             break;
         case MSG_ACT_STOP:
-            test_stop();
-            break;
         case MSG_ACT_STATUS:
-            reportStatus();
+            // Replies take hundreds of ms, do not send them from here
+            pendingCtrlAction = control_p->action;
             break;
+        case MSG_ACT_ACK:
+            if( control_p->seq == ctrlSeq ) fl_CtrlAcked = true;
+            break;
+#ifdef CHECKPOINT_INTERVAL_MS
+        case PH_ACT_RESUME:
+            fl_resume = true;
+            fl_test_restart = true;
+            pendingCtrlAction = MSG_ACT_RESTART;
+            break;
+#endif
         }
         break;
     
     case PH_MSG_Config:
-        config_new(test_p);
-        fl_test_restart = true;
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, test_config_t, break );
+        // No test running: restart with it, as the first entry
+        if( !fl_testRunning ){
+            if( config_check(test_p, NULL) ){
+                memcpy(&pendingConfig, test_p, sizeof(test_config_t));
+                fl_configStopped = true;
+                fl_test_restart = true;
+            }
+            else {
+                fl_configRejected = true;
+            }
+            break;
+        }
+        // Double buffered: the running config is replaced by test_next().
+        // A shard keeps the step counts of testSet[].
+        if( config_swap_allowed(test_p) && config_check(test_p, NULL) ){
+            memcpy(&pendingConfig, test_p, sizeof(test_config_t));
+            fl_configTlv = false;
+            fl_configPending = true;
+        }
+        else {
+            fl_configRejected = true;
+        }
+        break;
+
+    case PH_MSG_ConfigTlv:
+        // Applied on top of the running config, then as PH_MSG_Config
+        MSG_CHECK_FOR_PAYLOAD(radioBuffer, phaser_tlv_chunk_t, break );
+        tlvLen = tlv_rx_chunk(&tlvRx, tlv_p, getTimeMs());
+        if( tlvLen == 0 ) break;
+        memcpy(&tlvConfig, &test_config, sizeof(test_config_t));
+        if( !fl_configPending
+                && tlv_parse(tlvRx.buf, tlvLen, &tlvConfig, &pendingSpec)
+                && config_swap_allowed(&tlvConfig)
+                && config_check(&tlvConfig, &pendingSpec) ){
+            memcpy(&pendingConfig, &tlvConfig, sizeof(test_config_t));
+            fl_configTlv = true;
+            fl_configPending = true;
+        }
+        else {
+            fl_configRejected = true;
+        }
+        break;
+
+    case PH_MSG_Converged:
+        if( converged_p->expIdx == ant_cfg_p->expIdx && converged_p->nodeId == PH_NODE_ID ){
+            fl_expConverged = true;
+        }
+        break;
+
+    case PH_MSG_Result:
+        if( result_p->action == MSG_ACT_ACK && result_p->expIdx == result_msg.payload.expIdx
+                && result_p->nodeId == PH_NODE_ID ){
+            memcpy(&lastResult, result_p, sizeof(phaser_result_t));
+            fl_ResultRecv = true;
+        }
+        break;
+
+    case PH_MSG_Echo:
+        // Received with the antenna state of the experiment
+        if( echo_p->expIdx == ant_cfg_p->expIdx && echo_p->nodeId == PH_NODE_ID ){
+            STREAM_STAT_ADD(echoRssi, radioGetLastRSSI());
+            STREAM_STAT_ADD(echoLqi, radioGetLastLQI());
+        }
+        break;
+
+    case PH_MSG_Shard:
+        // The campaign restarts with the shard
+        if( shard_p->action == MSG_ACT_SET ){
+            memcpy(&pendingShard, shard_p, sizeof(phaser_shard_t));
+            fl_shardPending = true;
+            fl_test_restart = true;
+            pendingCtrlAction = MSG_ACT_RESTART;
+        }
+        break;
+
+#ifdef TRACE_PHASES
+    case PH_MSG_Trace:
+        // Dumped between the test steps
+        if( trace_p->action == MSG_ACT_STATUS
+                && (trace_p->nodeId == PH_NODE_ID || trace_p->nodeId == PH_NODE_ALL) ){
+            fl_traceDump = true;
+        }
         break;
+#endif
+
+#ifdef TDMA_SLOTTED
+    case PH_MSG_Beacon:
+        if( beacon_p->nodeId != PH_NODE_ALL ) break;   // Another node
+        tdmaRef = getTimeMs();
+        memcpy(&tdmaBeacon, beacon_p, sizeof(phaser_beacon_t));
+        fl_tdmaSync = true;
+        fl_tdmaBeacon = true;
+        break;
+#endif
     }
     // Rx processing done
     flRxProcessing=false;
 }
 
+// -------------------------------------------------------------------------
+// Wired stepper link: send a message, receive the ACK
+// -------------------------------------------------------------------------
+#ifdef STEPPER_WIRED
+void stepper_link_send(const void *msg, uint8_t len)
+{
+    const uint8_t *p = msg;
+    serialSendByte(STEPPER_LINK_SERIAL_ID, STEPPER_LINK_SYNC);
+    serialSendByte(STEPPER_LINK_SERIAL_ID, len);
+    while( len-- ) serialSendByte(STEPPER_LINK_SERIAL_ID, *p++);
+}
+
+void onLinkRecv(uint8_t b)
+{
+    switch( linkState ){
+    case STEPPER_LINK_WAIT_SYNC:
+        if( b == STEPPER_LINK_SYNC ) linkState = STEPPER_LINK_WAIT_LEN;
+        break;
+    case STEPPER_LINK_WAIT_LEN:
+        linkLen = b;
+        linkPos = 0;
+        linkState = (b > 0 && b <= sizeof(linkBuffer)) ? STEPPER_LINK_DATA : STEPPER_LINK_WAIT_SYNC;
+        break;
+    case STEPPER_LINK_DATA:
+        ((uint8_t *)&linkBuffer)[linkPos++] = b;
+        if( linkPos < linkLen ) break;
+        linkState = STEPPER_LINK_WAIT_SYNC;
+
+        if( ! MSG_SIGNATURE_OK(linkBuffer) ) break;
+        MSG_NEW_PAYLOAD_PTR(linkBuffer, phaser_angle_t, angle_p);
+        if( linkBuffer.id == PH_MSG_Angle && angle_p->action == MSG_ACT_ACK ){
+            fl_AngleSet = true;
+        }
+        break;
+    }
+}
+#endif
+
+#ifdef TDMA_SLOTTED
+// -------------------------------------------------------------------------
+// TDMA waits sleep in low power mode towards the time t, in steps of at
+// most one slot. The radio IRQ does not end msleep(), the beacons and
+// control messages received meanwhile are seen after the step.
+// -------------------------------------------------------------------------
+#define TDMA_SLEEP_STEP_MS  PH_TDMA_SLOT_MS
+
+static void tdma_sleep(uint32_t t)
+{
+    int32_t left = t - getTimeMs();
+
+    if( left <= 0 ) return;
+    msleep( (left > TDMA_SLEEP_STEP_MS) ? TDMA_SLEEP_STEP_MS : left );
+}
+
+// -------------------------------------------------------------------------
+// TDMA, node 0: wait until the other active nodes are done at the angle.
+// No wait without the monitor beacon.
+// -------------------------------------------------------------------------
+void tdma_wait_ready()
+{
+    uint32_t start = getTimeMs();
+    uint8_t others;
+
+    fl_tdmaBeacon = false;
+    while( getTimeMs() - start < PH_TDMA_WAIT_MS ){
+        if( !fl_tdmaSync || getTimeMs() - tdmaRef > 2*PH_TDMA_BEACON_MS ) return;
+        if( fl_tdmaBeacon ){
+            fl_tdmaBeacon = false;
+            others = tdmaBeacon.activeMask & ~1;
+            if( (tdmaBeacon.readyMask & others) == others ) return;
+        }
+        if( fl_test_restart ) return;
+        tdma_sleep(start + PH_TDMA_WAIT_MS);
+    }
+#ifdef DEBUG_PHASER
+    PRINTF("TDMA: nodes not ready\n");
+#endif
+}
+
+// -------------------------------------------------------------------------
+// TDMA, other nodes: report ready and wait for node 0 to move the stepper.
+// Return true when the beacon reports the angle.
+// -------------------------------------------------------------------------
+bool tdma_wait_angle(angle_t newAngle)
+{
+    uint32_t start = getTimeMs();
+    uint32_t sent;
+    phaser_beacon_t *b = &(beacon_msg.payload);
+
+    // The stepper recalibration is done by node 0
+    if( (int16_t)newAngle < 0 ) return false;
+
+    b->angle = newAngle;
+    b->nodeId = PH_NODE_ID;
+    MSG_DO_CHECKSUM( beacon_msg );
+
+    fl_tdmaBeacon = false;
+    tx_drain();
+    radio_set_power(RADIO_MAX_TX_POWER);
+    MSG_RADIO_SEND( beacon_msg );
+    sent = getTimeMs();
+
+    while( getTimeMs() - start < PH_TDMA_WAIT_MS && !fl_test_restart ){
+        if( fl_tdmaBeacon ){
+            fl_tdmaBeacon = false;
+            if( tdmaBeacon.angle == newAngle ){
+                lastAngle = newAngle;
+                return true;
+            }
+            // Ready report lost: again, at most twice per monitor beacon
+            if( !(tdmaBeacon.readyMask & (1 << PH_NODE_ID))
+                    && getTimeMs() - sent >= PH_TDMA_BEACON_MS / 2 ){
+                MSG_RADIO_SEND( beacon_msg );
+                sent = getTimeMs();
+            }
+        }
+        tdma_sleep(start + PH_TDMA_WAIT_MS);
+    }
+    return false;
+}
+#endif
+
 // -------------------------------------------------------------------------
 // Set the physical angle of the antena module
 // Return true if the angle was changed.
 // -------------------------------------------------------------------------
 bool set_angle( angle_t newAngle )
 {
+#ifdef STEPPER_WIRED
+    int i;
+    uint32_t sent;
+#endif
+
     if( newAngle==lastAngle && newAngle != ANGLE_NOT_SET_VALUE) return false;
 
+#ifdef TDMA_SLOTTED
+    if( PH_NODE_ID != 0 ) return tdma_wait_angle(newAngle);
+    tdma_wait_ready();
+#endif
+
     angle_msg.payload.angle = newAngle;
     angle_msg.payload.action = MSG_ACT_SET;
     MSG_DO_CHECKSUM( angle_msg );
 
-    radioSetTxPower(RADIO_MAX_TX_POWER);
-
     fl_AngleSet=false;
+#ifdef STEPPER_WIRED
+    // The stepper ACKs when the move is done. Send again once if lost.
+    for(i=0; i<2 && !fl_AngleSet; i++){
+        stepper_link_send(&angle_msg, sizeof(angle_msg));
+        sent = getTimeMs();
+        while( !fl_AngleSet && getTimeMs() - sent < STEPPER_LINK_TIMEOUT_MS );
+    }
+#else
+    // The stepper stays on the home channel
+    channel_set(PH_CHANNEL_HOME);
+
+    tx_drain();
+    radio_set_power(RADIO_MAX_TX_POWER);
+
     MSG_RADIO_SEND_FOR_ACK( angle_msg, fl_AngleSet );
+#endif
+
+    // Remember the angle, so unchanged angles are not sent again
+    if( fl_AngleSet ) lastAngle = newAngle;
 
     return( fl_AngleSet );
 }
 
 // -------------------------------------------------------------------------
-// Setup the test run
+// Beam search: get the RSSI mean of the experiment from the monitor.
+// Return false if no result.
 // -------------------------------------------------------------------------
-void test_init()
+bool request_result(uint16_t expIdx, int16_t *rssi)
 {
-    // Init the test infrastructure
-    lastAngle = ANGLE_NOT_SET_VALUE;    // Force stepper angle recalibration
-    set_angle( -20 );
-    set_angle( 0 );
+    result_msg.payload.expIdx = expIdx;
+    result_msg.payload.action = MSG_ACT_STATUS;
+    MSG_DO_CHECKSUM( result_msg );
 
-    // Init the iterators
+    tx_drain();
+    radio_set_power(RADIO_MAX_TX_POWER);
+
+    fl_ResultRecv=false;
+    MSG_RADIO_SEND_FOR_ACK( result_msg, fl_ResultRecv );
+
+    if( !fl_ResultRecv || lastResult.num == 0 ) return false;
+    *rssi = lastResult.rssi;
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// Beam search: set the state to measure next
+// -------------------------------------------------------------------------
+void search_apply(uint16_t kA, uint16_t kB)
+{
     testIdx.power.idx = 0;
+    testIdx.phaseA.idx = kA;
+    testIdx.phaseB.idx = kB;
+    ant_cfg_p->power = test_config.power[0];
+    ant_test_state(&test_config, kA, kB, &(ant_cfg_p->ant));
+}
+
+// -------------------------------------------------------------------------
+// Beam search and tracking: report the best state to the monitor
+// -------------------------------------------------------------------------
+void result_report(uint16_t kA, uint16_t kB, int16_t rssi, uint16_t num)
+{
+    result_msg.payload.expIdx = ant_cfg_p->expIdx;
+    result_msg.payload.rssi = rssi;
+    result_msg.payload.num = num;
+    result_msg.payload.angle = ant_cfg_p->angle;
+    ant_test_state(&test_config, kA, kB, &(result_msg.payload.ant));
+    result_msg.payload.action = MSG_ACT_DONE;
+    MSG_DO_CHECKSUM( result_msg );
+
+    tx_drain();
+    radio_set_power(RADIO_MAX_TX_POWER);
+    MSG_RADIO_SEND( result_msg );
+
+#ifdef DEBUG_PHASER
+    PRINTF("Best: A=%d B=%d rssi=%d num=%d\n", (int)kA, (int)kB, (int)rssi, (int)num);
+#endif
+}
+
+// -------------------------------------------------------------------------
+// Settle calibration: measure the state at the end (0: first, 1: last of
+// both dimensions), delay us after switching from the other end.
+// -------------------------------------------------------------------------
+void settle_apply(uint8_t end, uint16_t delayUs)
+{
+    uint16_t lastA = sched.countA ? sched.countA - 1 : 0;
+    uint16_t lastB = sched.countB ? sched.countB - 1 : 0;
+
+    if( end ){
+        search_apply(lastA, lastB);
+        ant_test_state(&test_config, 0, 0, &settleFrom);
+    }
+    else {
+        search_apply(0, 0);
+        ant_test_state(&test_config, lastA, lastB, &settleFrom);
+    }
+    settleDelayUs = delayUs;
+}
+
+// -------------------------------------------------------------------------
+// Settle calibration: switch to the measured state before a ping.
+// The CCA may still delay the ping, the delay found is an upper bound.
+// -------------------------------------------------------------------------
+void settle_switch()
+{
+    while( cc2420IsTxBusy() );
+
+    ant_test_stage(&settleFrom);
+    ant_test_latch();
+    udelay(SETTLE_REF_US);
+
+    ant_test_stage(&ant_cfg_p->ant);
+    ant_test_latch();
+    if( settleDelayUs ) udelay(settleDelayUs);
+}
+
+// -------------------------------------------------------------------------
+// Settle calibration done: use the settle time found, report it
+// -------------------------------------------------------------------------
+void settle_done()
+{
+    if( settle.bestUs != SETTLE_NONE ){
+        ant_test_set_settle(settle.bestUs);
+        // Loaded by ant_driver_init() after a reboot
+        checkpoint_settle_save(ant_driver_name, settle.bestUs);
+    }
+
+    result_msg.payload.expIdx = ant_cfg_p->expIdx;
+    result_msg.payload.rssi = settle.ref[0];
+    result_msg.payload.num = settle.bestUs;
+    result_msg.payload.angle = ant_cfg_p->angle;
+    result_msg.payload.ant = ant_cfg_p->ant;
+    result_msg.payload.action = MSG_ACT_SET;
+    MSG_DO_CHECKSUM( result_msg );
+
+    tx_drain();
+    radio_set_power(RADIO_MAX_TX_POWER);
+    MSG_RADIO_SEND( result_msg );
+
+#ifdef DEBUG_PHASER
+    PRINTF("Settle: %u us\n", (unsigned)settle.bestUs);
+#endif
+}
+
+// -------------------------------------------------------------------------
+// Start the sweep over the antenna states at an angle
+// -------------------------------------------------------------------------
+void test_sweep_start()
+{
+    uint16_t kA, kB;
+    uint16_t delayUs;
+    uint8_t end;
+
+    schedIdx = 0;
+    schedule_step(&sched, schedIdx, &testIdx, ant_cfg_p);
+#ifdef PING_COMPACT
+    fl_anchorPending = true;
+#endif
+
+    if( test_config.sweep_mode == SWEEP_MODE_SEARCH ){
+        search_start(&search, sched.countA, sched.countB, test_config.search_coarse, &kA, &kB);
+        search_apply(kA, kB);
+    }
+    if( test_config.sweep_mode == SWEEP_MODE_TRACK ){
+        kA = kB = 0;
+        track_start(&track, sched.countA, sched.countB,
+            test_config.track_step, test_config.track_hyst, &kA, &kB);
+        search_apply(kA, kB);
+    }
+    if( test_config.sweep_mode == SWEEP_MODE_SETTLE ){
+        settle_start(&settle, test_config.settle_tol, &delayUs, &end);
+        settle_apply(end, delayUs);
+    }
+}
+
+// -------------------------------------------------------------------------
+// Start the sweep schedule of test_config at its first step
+// -------------------------------------------------------------------------
+void test_sched_init()
+{
+    // The same state may have a different encoding in the new config
+    ant_test_config(&test_config);
+    fl_antLatchedValid = false;
+
+    schedule_init(&sched, &test_config, &sweepSpec);
+    test_sweep_start();
+}
+
+// -------------------------------------------------------------------------
+// Merged campaign: load the entry for the current plan position.
+// Entries that do not visit the current angle are skipped.
+// Return false when no more entries at this angle.
+// -------------------------------------------------------------------------
+#ifdef CAMPAIGN_MERGED
+bool plan_segment_load()
+{
+    int idx;
+    uint16_t angleNum;
+
+    for( ; planEntryPos < plan.entryCount; planEntryPos++){
+        idx = campaign_entry(&plan, planAngleNum, planEntryPos);
+        if( !campaign_entry_has_angle(&(testSet[idx]), ant_cfg_p->angle) ) continue;
+
+        config_counter = idx;
+        if( idx == swapIdx ){
+            memcpy(&test_config, &swapConfig, sizeof(test_config_t));
+            memcpy(&sweepSpec, &swapSpec, sizeof(sweep_spec_t));
+            fl_configTlvRun = fl_swapTlv;
+        }
+        else {
+            memcpy(&test_config, &(testSet[idx]), sizeof(test_config_t));
+            sweepSpec.dimCount = 0;
+            fl_configTlvRun = false;
+        }
+        test_config.config_idx = idx;
+
+        ant_cfg_p->configIdx = idx;
+        test_sched_init();
+
+        // Numbered as in the sequential run of the entry, as the shards are:
+        // its angle number, not the one of the merged sweep
+        angleNum = test_config.angle_step ? ant_cfg_p->angle / test_config.angle_step : 0;
+        ant_cfg_p->expIdx = angleNum * sched.count;
+        return true;
+    }
+    return false;
+}
+
+// -------------------------------------------------------------------------
+// Merged campaign: next entry at this angle, or the next angle.
+// Return false when the campaign is done.
+// -------------------------------------------------------------------------
+bool plan_next_segment()
+{
+    int angle;
+
+    planEntryPos++;
+    if( plan_segment_load() ) return true;
+
+    angle = campaign_next_angle(&plan, ant_cfg_p->angle);
+    if( angle < 0 ){
+        fl_planPassDone = true;
+        return false;
+    }
+
+    ant_cfg_p->angle = angle;
+    planAngleNum++;
+    planEntryPos = 0;
+    return plan_segment_load();
+}
+#endif
+
+// -------------------------------------------------------------------------
+// Sharded campaign: set up the current experiment of the shard.
+// A new entry is announced as next_config() does.
+// -------------------------------------------------------------------------
+void shard_seek(bool flAnnounce)
+{
+    uint8_t entry;
+    uint16_t angleNum;
+    uint32_t step;
+
+    shard_locate(testSet, testSet_size, shard.cur, &entry, &angleNum, &step);
+
+    if( entry != config_counter || !flAnnounce ){
+        if( flAnnounce ) send_ctrl_msg(MSG_ACT_DONE);    // Previous configuration done
+        config_counter = entry;
+        config_new(&(testSet[entry]));
+        test_config.config_idx = entry;
+        ant_cfg_p->configIdx = entry;
+        testIdx.angle.limit = test_config.angle_count;
+        test_sched_init();
+        if( flAnnounce ) test_start();
+    }
+
+    testIdx.angle.idx = angleNum;
+    ant_cfg_p->angle = angleNum * test_config.angle_step;
+    schedIdx = step;
+    schedule_step(&sched, schedIdx, &testIdx, ant_cfg_p);
+
+    // Numbered as in the sequential run of the entry
+    ant_cfg_p->expIdx = angleNum * sched.count + step;
+}
+
+// -------------------------------------------------------------------------
+// Apply the shard assignment received, if any, and reply with it
+// -------------------------------------------------------------------------
+void shard_apply()
+{
+    phaser_shard_t *s = &(shard_msg.payload);
+    shard_t sh;
+    bool flOK = true;
+
+    if( !fl_shardPending ) return;
+    fl_shardPending = false;
+    memcpy(s, &pendingShard, sizeof(phaser_shard_t));
+
+    if( s->shardCount <= 1 ){
+        shard.active = false;
+    }
+    else if( shard_init(&sh, testSet, testSet_size, s->shardIdx, s->shardCount, s->mode) ){
+        shard = sh;
+    }
+    else {
+        flOK = false;   // The previous assignment is kept
+    }
+
+    s->action = flOK ? MSG_ACT_ACK : MSG_ACT_STOP;
+    s->first = shard.active ? shard.cur : 0;
+    s->end = shard.active ? shard.end : shard_total(testSet, testSet_size);
+    MSG_DO_CHECKSUM( shard_msg );
+
+    tx_drain();
+    radio_set_power(RADIO_MAX_TX_POWER);
+    MSG_RADIO_SEND( shard_msg );
+
+#ifdef CHECKPOINT_INTERVAL_MS
+    // The cursor is of the previous assignment
+    if( flOK ){
+        checkpoint_clear();
+        fl_checkpointValid = false;
+    }
+#endif
+#ifdef DEBUG_PHASER
+    PRINTF("Shard: %d/%d exp %ld..%ld\n", (int)s->shardIdx, (int)s->shardCount,
+        (long)s->first, (long)s->end);
+#endif
+}
+
+// -------------------------------------------------------------------------
+// Setup the test run
+// -------------------------------------------------------------------------
+void test_init()
+{
+#ifdef CAMPAIGN_MERGED
+    // Serpentine passes: a merged campaign that ran to the end runs again
+    // from its last angle, the other way. The stepper is recalibrated
+    // before the ascending passes only.
+    fl_planDescending = plan.merged && fl_planPassDone && !fl_planDescending;
+    fl_planPassDone = false;
+    plan.descending = fl_planDescending;
+    if( !plan.descending )
+#endif
+    {
+        // Init the test infrastructure
+        lastAngle = ANGLE_NOT_SET_VALUE;    // Force stepper angle recalibration
+        set_angle( -20 );
+        set_angle( 0 );
+    }
+
+    // Init the iterators
     testIdx.angle.idx = 0;
     testIdx.angle.limit = test_config.angle_count;
 
@@ -286,9 +1415,40 @@ void test_init()
     ant_cfg_p->expIdx = 0;
     ant_cfg_p->msgCounter = 0;
     ant_cfg_p->angle = 0;
-    ant_cfg_p->power = test_config.power[0];
+    ant_cfg_p->configIdx = config_counter;
+    test_config.config_idx = config_counter;
+
+    test_sched_init();
+
+    if( shard.active ) shard_seek(false);
+
+#ifdef CAMPAIGN_MERGED
+    if( plan.merged ){
+        ant_cfg_p->angle = campaign_next_angle(&plan, -1);
+        planAngleNum = 0;
+        planEntryPos = 0;
+        plan_segment_load();
+    }
+#endif
 
-    ant_test_init(&testIdx, &test_config, ant_cfg_p);
+    // Force the antenna setup on the first step
+    fl_antLatchedValid = false;
+    fl_antStaged = false;
+}
+
+// -------------------------------------------------------------------------
+// Stage the next antenna state in the driver, if it differs from the
+// latched one. Runs while the last ping of the previous step is still
+// being transmitted; the state is latched by test_step().
+// -------------------------------------------------------------------------
+void ant_stage_next()
+{
+    if( fl_antLatchedValid && ANT_STATE_EQ(&antLatched, &ant_cfg_p->ant) ){
+        fl_antStaged = false;
+        return;
+    }
+    ant_test_stage(&ant_cfg_p->ant);
+    fl_antStaged = true;
 }
 
 // -------------------------------------------------------------------------
@@ -296,7 +1456,7 @@ void test_init()
 // -------------------------------------------------------------------------
 bool next_config()
 {
-    test_config_t *cfg;
+    const test_config_t *cfg;
 
     if( ++config_counter >= testSet_size ){
         config_counter=0;
@@ -316,25 +1476,75 @@ bool next_config()
 // Return true when next iteration is ready
 // Return false when done (no more iterations possible)
 // -------------------------------------------------------------------------
-bool test_next()
+bool test_next_step()
 {
-    ant_cfg_p->expIdx ++;
+    uint16_t kA, kB;
+    int16_t rssi = 0;
+    bool flValid;
+    uint16_t delayUs;
+    uint8_t end;
+
+    if( test_config.sweep_mode == SWEEP_MODE_SEARCH ){
+        // Next state of the beam search
+        flValid = request_result(ant_cfg_p->expIdx, &rssi);
+        ant_cfg_p->expIdx ++;
+        if( search_next(&search, rssi, flValid, &kA, &kB) ){
+            search_apply(kA, kB);
+            return true;
+        }
+        result_report(search.bestA, search.bestB, search.bestRssi, search.steps);
+    }
+    else if( test_config.sweep_mode == SWEEP_MODE_TRACK ){
+        // Beam tracking runs until restart or stop
+        flValid = request_result(ant_cfg_p->expIdx, &rssi);
+        ant_cfg_p->expIdx ++;
+        if( track_next(&track, rssi, flValid, &kA, &kB) ){
+            result_report(track.curA, track.curB, track.curRssi, track.moves);
+        }
+        search_apply(kA, kB);
+        return true;
+    }
+    else if( test_config.sweep_mode == SWEEP_MODE_CW ){
+        // The whole sweep at the angle was one carrier burst
+        ant_cfg_p->expIdx += sched.count;
+    }
+    else if( test_config.sweep_mode == SWEEP_MODE_SETTLE ){
+        // Next delay or state of the settle calibration
+        flValid = request_result(ant_cfg_p->expIdx, &rssi);
+        ant_cfg_p->expIdx ++;
+        if( settle_next(&settle, rssi, flValid, &delayUs, &end) ){
+            settle_apply(end, delayUs);
+            return true;
+        }
+        settle_done();
+    }
+    else {
+        ant_cfg_p->expIdx ++;
+
+        // Next experiment of the shard, at any place of the campaign
+        if( shard.active ){
+            if( shard_next(&shard) ){
+                shard_seek(true);
+                return true;
+            }
+            send_ctrl_msg(MSG_ACT_DONE);
+            return false;
+        }
 
-    // Next power
-    testIdx.power.idx++;
-    if( testIdx.power.idx < TEST_CONFIG_POWER_LIST_SIZE ){
-        ant_cfg_p->power = test_config.power[testIdx.power.idx];
-        if( ant_cfg_p->power > 0 ){
-            return true; 
-        }  
+        // Next power and hardware configuration
+        if( ++schedIdx < sched.count ){
+            schedule_step(&sched, schedIdx, &testIdx, ant_cfg_p);
+            return true;
+        }
     }
-    testIdx.power.idx = 0;
-    ant_cfg_p->power = test_config.power[testIdx.power.idx];
+    test_sweep_start();
 
-    // Next hardware configuration
-    if( ant_test_next_config(&testIdx, &test_config, ant_cfg_p) ){
-        return true;
+#ifdef CAMPAIGN_MERGED
+    // Next entry or angle of the merged campaign
+    if( plan.merged ){
+        return plan_next_segment();
     }
+#endif
 
     // Next angle
     testIdx.angle.idx++;
@@ -354,29 +1564,604 @@ bool test_next()
     return false;
 }
 
+// -------------------------------------------------------------------------
+// Reply to the config received during the test
+// -------------------------------------------------------------------------
+void config_ack_send(msg_action_t act)
+{
+    config_ack_msg.payload.epoch = configEpoch;
+    config_ack_msg.payload.configIdx = test_config.config_idx;
+    config_ack_msg.payload.expIdx = ant_cfg_p->expIdx;
+    config_ack_msg.payload.action = act;
+    MSG_DO_CHECKSUM( config_ack_msg );
+
+    tx_drain();
+    radio_set_power(RADIO_MAX_TX_POWER);
+    MSG_RADIO_SEND( config_ack_msg );
+}
+
+// -------------------------------------------------------------------------
+// Swap in the config received during the test, if any.
+// The sweep at the current angle restarts with it; the stepper position
+// and the counters are kept. Return true if swapped.
+// -------------------------------------------------------------------------
+bool config_swap()
+{
+    Handle_t h;
+    bool flExpired;
+
+    if( fl_configRejected ){
+        fl_configRejected = false;
+        config_ack_send(MSG_ACT_STOP);
+    }
+    // TLV chunks are not acknowledged: report the lost ones
+    ATOMIC_START(h);
+    flExpired = tlv_rx_expired(&tlvRx, getTimeMs());
+    ATOMIC_END(h);
+    if( flExpired ) config_ack_send(PH_ACT_INCOMPLETE);
+
+    if( !fl_configPending ) return false;
+
+    ATOMIC_START(h);
+    memcpy(&test_config, &pendingConfig, sizeof(test_config_t));
+    if( fl_configTlv ) memcpy(&sweepSpec, &pendingSpec, sizeof(sweep_spec_t));
+    else sweepSpec.dimCount = 0;
+    fl_configTlvRun = fl_configTlv;
+    fl_configPending = false;
+    ATOMIC_END(h);
+
+    test_config.config_idx = ant_cfg_p->configIdx;
+    testIdx.angle.limit = test_config.angle_count;
+    configEpoch++;
+
+#ifdef CAMPAIGN_MERGED
+    // The next segments of the entry load it again
+    if( plan.merged ){
+        swapIdx = ant_cfg_p->configIdx;
+        memcpy(&swapConfig, &test_config, sizeof(test_config_t));
+        memcpy(&swapSpec, &sweepSpec, sizeof(sweep_spec_t));
+        fl_swapTlv = fl_configTlvRun;
+    }
+#endif
+
+    ant_cfg_p->expIdx ++;   // The experiment just run is done
+    test_sched_init();
+    // The config the monitor rebuilds the pings with, before the ACK.
+    // It does not parse the TLV records, and may have sent other configs.
+    send_test_config();
+    config_ack_send(MSG_ACT_ACK);
+
+#ifdef DEBUG_PHASER
+    PRINTF("Config swap: epoch=%d exp=%d\n", (int)configEpoch, (int)ant_cfg_p->expIdx);
+#endif
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// Next test step, with the antenna state staged for test_step().
+// -------------------------------------------------------------------------
+bool test_next()
+{
+    if( ! config_swap() ){
+        if( ! test_next_step() ) return false;
+    }
+    ant_stage_next();
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// Checkpoint: save the cursor of the next step, at most every
+// CHECKPOINT_INTERVAL_MS. The search, tracking and settle modes resume
+// from the start of the sweep at the angle.
+// -------------------------------------------------------------------------
+#ifdef CHECKPOINT_INTERVAL_MS
+void checkpoint_tick()
+{
+    uint32_t now = getTimeMs();
+    if( now - checkpointTime < CHECKPOINT_INTERVAL_MS ) return;
+    checkpointTime = now;
+
+    checkpoint.testSetSig = checkpoint_sum(testSet, testSet_size * sizeof(test_config_t));
+    checkpoint.configCounter = config_counter;
+    checkpoint.flags = 0;
+    checkpoint.msgCounter = ant_cfg_p->msgCounter;
+    if( shard.active ){
+        checkpoint.flags |= CP_FL_SHARD;
+        checkpoint.shardCur = shard.cur;
+        checkpoint.shardEnd = shard.end;
+        checkpoint.shardStride = shard.stride;
+    }
+    else {
+        checkpoint.angleIdx = testIdx.angle.idx;
+        checkpoint.schedIdx = schedIdx;
+        checkpoint.expIdx = ant_cfg_p->expIdx;
+        checkpoint.angle = ant_cfg_p->angle;
+#ifdef CAMPAIGN_MERGED
+        checkpoint.planAngleNum = planAngleNum;
+        checkpoint.planEntryPos = planEntryPos;
+        if( fl_planDescending ) checkpoint.flags |= CP_FL_DESCENDING;
+#endif
+    }
+    checkpoint_save(&checkpoint);
+    fl_checkpointValid = true;
+}
+
+// -------------------------------------------------------------------------
+// Set up the test run at the checkpoint, instead of test_init().
+// Return false if there is nothing to resume.
+// -------------------------------------------------------------------------
+bool test_resume()
+{
+    const checkpoint_t *cp = &checkpoint;
+
+    if( !fl_resume ) return false;
+    fl_resume = false;
+
+    if( !fl_checkpointValid ) return false;
+    if( cp->testSetSig != checkpoint_sum(testSet, testSet_size * sizeof(test_config_t)) ) return false;
+    if( cp->configCounter >= testSet_size ) return false;
+
+    config_counter = cp->configCounter;
+    if( !config_new(&(testSet[config_counter])) ) return false;
+
+    // test_init() seeks to the shard cursor
+    if( cp->flags & CP_FL_SHARD ){
+        shard.cur = cp->shardCur;
+        shard.end = cp->shardEnd;
+        shard.stride = cp->shardStride;
+        shard.active = true;
+#ifdef CAMPAIGN_MERGED
+        plan.merged = false;
+#endif
+    }
+    test_init();
+    ant_cfg_p->msgCounter = cp->msgCounter;
+
+    if( !shard.active ){
+        testIdx.angle.idx = cp->angleIdx;
+        ant_cfg_p->angle = cp->angle;
+#ifdef CAMPAIGN_MERGED
+        if( plan.merged ){
+            planAngleNum = cp->planAngleNum;
+            planEntryPos = cp->planEntryPos;
+            fl_planDescending = (cp->flags & CP_FL_DESCENDING) != 0;
+            plan.descending = fl_planDescending;
+            if( !plan_segment_load() ) return false;
+        }
+#endif
+        ant_cfg_p->expIdx = cp->expIdx;
+        if( test_config.sweep_mode == SWEEP_MODE_FULL && cp->schedIdx < sched.count ){
+            schedIdx = cp->schedIdx;
+            schedule_step(&sched, schedIdx, &testIdx, ant_cfg_p);
+        }
+    }
+    checkpointTime = getTimeMs();
+
+#ifdef DEBUG_PHASER
+    PRINTF("Resume: config=%d exp=%d angle=%d\n",
+        (int)config_counter, (int)ant_cfg_p->expIdx, (int)ant_cfg_p->angle);
+#endif
+    return true;
+}
+#endif
+
+// -------------------------------------------------------------------------
+// Process the control action received by onRadioRecv(), if any.
+// Called between the TX slots and from the main loop.
+// -------------------------------------------------------------------------
+void ctrl_process_pending()
+{
+    msg_action_t act = pendingCtrlAction;
+    if( act == MSG_ACT_CLEAR ) return;
+    pendingCtrlAction = MSG_ACT_CLEAR;
+
+    switch( act ){
+    case MSG_ACT_RESTART:
+        send_ctrl_msg(MSG_ACT_IDLE);
+        break;
+    case MSG_ACT_STOP:
+        test_stop();
+        break;
+    case MSG_ACT_STATUS:
+        reportStatus();
+        break;
+    }
+}
+
+// -------------------------------------------------------------------------
+// TX pacing.
+// Slots are kept on an absolute grid of slot timer ticks, so the loop
+// overhead does not add up to the send_delay. The CPU sleeps in LPM0
+// until the compare interrupt, and handles the control messages between
+// the slots.
+// -------------------------------------------------------------------------
+#ifdef TX_PACING_TIMER
+ISR(TIMERB1, txSlotTimerInterrupt)
+{
+    // Reading TBIV clears the pending flag
+    if( TBIV == TBIV_TBCCR1 ){
+        TBCCTL1 = 0;
+        fl_txSlotTick = true;
+        __bic_SR_register_on_exit(LPM0_bits);
+    }
+}
+
+// Timer B runs free from ACLK. Reads of the asynchronous counter are
+// repeated until stable.
+static uint16_t tx_slot_now()
+{
+    uint16_t t;
+    do{
+        t = TBR;
+    } while( t != TBR );
+    return t;
+}
+
+void tx_slot_init()
+{
+    TBCCTL1 = 0;
+    TBCTL = TBSSEL_1 | MC_2 | TBCLR;
+}
+
+void tx_slot_start()
+{
+    txSlotTick = tx_slot_now();
+    txSlotFrac = 0;
+}
+
+// Arm the compare ticks after the last one.
+// Returns false if that time has already passed.
+static bool tx_slot_arm(uint16_t ticks)
+{
+    Handle_t h;
+    bool armed = true;
+
+    ATOMIC_START(h);
+    txSlotTick += ticks;
+    fl_txSlotTick = false;
+    TBCCR1 = txSlotTick;
+    TBCCTL1 = CCIE;
+    if( (int16_t)(txSlotTick - tx_slot_now()) <= 0 ){
+        TBCCTL1 = 0;
+        armed = false;
+    }
+    ATOMIC_END(h);
+    return armed;
+}
+
+// Sleep until the compare. Interrupts are enabled by the LPM entry itself,
+// so the compare can not slip in between the check and the sleep. Other
+// interrupts ending LPM0 just go back to sleep.
+static void tx_slot_sleep()
+{
+    for(;;){
+        __dint();
+        if( fl_txSlotTick ) break;
+        __bis_SR_register(LPM0_bits | GIE);
+    }
+    __eint();
+}
+
+void tx_slot_wait(uint16_t period)
+{
+    uint32_t ticks;
+    uint16_t step;
+
+    ticks = (uint32_t)period * TX_SLOT_TICK_HZ + txSlotFrac;
+    txSlotFrac = ticks % 1000;
+    ticks /= 1000;
+
+    while( ticks ){
+        step = (ticks > TX_SLOT_STEP_TICKS) ? TX_SLOT_STEP_TICKS : ticks;
+        ticks -= step;
+        if( !tx_slot_arm(step) ){
+            // Late: send now and realign the grid, do not burst to catch up
+            if( ticks == 0 ) txSlotTick = tx_slot_now();
+            continue;
+        }
+        tx_slot_sleep();
+        ctrl_process_pending();
+        if( fl_test_restart || fl_test_stop ) return;
+    }
+    ctrl_process_pending();
+}
+#endif
+
+// -------------------------------------------------------------------------
+// TDMA pacing: wait for the slot of the node, at least period ms after
+// the previous ping. Without a recent beacon the slot grid is not used.
+// -------------------------------------------------------------------------
+#ifdef TDMA_SLOTTED
+void tdma_slot_wait(uint16_t period)
+{
+    Handle_t h;
+    uint32_t t, ref, slot;
+
+    t = tdmaLastPing + (period ? period : 1);
+    if( (int32_t)(t - getTimeMs()) < 0 ) t = getTimeMs();
+
+    ATOMIC_START(h);
+    ref = tdmaRef;
+    ATOMIC_END(h);
+
+    if( fl_tdmaSync && getTimeMs() - ref < 2*PH_TDMA_BEACON_MS ){
+        slot = ref + (PH_NODE_ID + 1) * PH_TDMA_SLOT_MS;
+        if( (int32_t)(t - slot) > 0 ){
+            slot += ((t - slot + PH_TDMA_FRAME_MS - 1) / PH_TDMA_FRAME_MS) * PH_TDMA_FRAME_MS;
+        }
+        t = slot;
+    }
+    tdmaLastPing = t;
+
+    while( (int32_t)(getTimeMs() - t) < 0 ){
+        ctrl_process_pending();
+        if( fl_test_restart || fl_test_stop ) return;
+        tdma_sleep(t);
+    }
+}
+#endif
+
+// -------------------------------------------------------------------------
+// Send the timing trace to the monitor, oldest entries first.
+// The trace restarts after the dump.
+// -------------------------------------------------------------------------
+#ifdef TRACE_PHASES
+void trace_dump()
+{
+    phaser_trace_t *t = &(trace_msg.payload);
+    uint16_t n, total = traceCount;
+    uint8_t i;
+
+    fl_traceDump = false;
+    tx_drain();
+    radio_set_power(RADIO_MAX_TX_POWER);
+
+    t->nodeId = PH_NODE_ID;
+    t->action = MSG_ACT_SET;
+    for(n=0; n<total; n+=t->count){
+        t->idx = n;
+        t->count = (total - n < PH_TRACE_CHUNK) ? total - n : PH_TRACE_CHUNK;
+        for(i=0; i<t->count; i++) t->e[i] = *trace_get(n + i);
+        MSG_DO_CHECKSUM( trace_msg );
+        MSG_RADIO_SEND( trace_msg );
+        mdelay(TRACE_CHUNK_DELAY_MS);
+    }
+
+    t->action = MSG_ACT_DONE;
+    t->idx = total;
+    t->count = 0;
+    t->lost = traceLost;
+    t->tickHz = TRACE_TICK_HZ;
+    MSG_DO_CHECKSUM( trace_msg );
+    MSG_RADIO_SEND( trace_msg );
+
+    trace_reset();
+    TRACE(TRACE_DUMP, 0);
+}
+#endif
+
+// -------------------------------------------------------------------------
+// Reverse link: send the RSSI/LQI of the echoes of the experiment pings
+// -------------------------------------------------------------------------
+void echo_report(uint16_t sent)
+{
+    phaser_echo_result_t *res = &(echo_result_msg.payload);
+    rssi_data_t rssi;
+    lqi_data_t lqi;
+    Handle_t h;
+
+    // The echo of the last ping
+    mdelay(ECHO_WAIT_MS);
+
+    // Late echoes are still added by onRadioRecv()
+    ATOMIC_START(h);
+    rssi = echoRssi;
+    lqi = echoLqi;
+    ATOMIC_END(h);
+
+    res->expIdx = ant_cfg_p->expIdx;
+    res->configIdx = ant_cfg_p->configIdx;
+    res->angle = ant_cfg_p->angle;
+    res->ant = ant_cfg_p->ant;
+    res->power = ant_cfg_p->power;
+    res->sent = sent;
+    res->num = rssi.num;
+    res->rssi = 0;
+    res->lqi = 0;
+    res->rssiDevSq = 0;
+    if( rssi.num > 0 ){
+        res->rssi = (rssi.sum * 4) / rssi.num;
+        res->lqi = STREAM_STAT_MEAN(lqi);
+        res->rssiDevSq = STREAM_STAT_DEVIATION_SQUARED(rssi);
+    }
+    // Not at the power of the experiment, it may be the lowest one
+    tx_drain();
+    radio_set_power(RADIO_MAX_TX_POWER);
+    MSG_DO_CHECKSUM( echo_result_msg );
+    MSG_RADIO_SEND( echo_result_msg );
+}
+
+// -------------------------------------------------------------------------
+// Continuous wave sweep of all the schedule steps at the angle, instead
+// of the pings. Each state is staged during the previous slot and latched
+// at the slot start, on an absolute ms grid. See phaser_cw_t.
+// -------------------------------------------------------------------------
+void cw_sweep()
+{
+    phaser_cw_t *cw = &(cw_msg.payload);
+    uint32_t n, slot, total, slotStart, t0;
+    bool flAcked;
+
+    set_angle(ant_cfg_p->angle);
+    channel_set(ant_cfg_p->channel);
+
+    cw->action = MSG_ACT_START;
+    cw->seq = ctrl_next_seq();
+    cw->expIdx = ant_cfg_p->expIdx;
+    cw->angle = ant_cfg_p->angle;
+    cw->configIdx = ant_cfg_p->configIdx;
+    cw->slotCount = sched.count;
+    cw->slotMs = test_config.send_delay;
+    cw->repeat = test_config.send_count;
+    MSG_DO_CHECKSUM( cw_msg );
+    CTRL_SEND_RELIABLE( cw_msg, flAcked );
+    if( !flAcked ) return;      // Nobody to measure
+
+    // Preamble: first state at the max power, for the carrier detection
+    schedule_step(&sched, 0, &testIdx, ant_cfg_p);
+    ant_test_stage(&ant_cfg_p->ant);
+    ant_test_latch();
+    radio_set_power(RADIO_MAX_TX_POWER);
+    mdelay(CW_LEAD_MS);
+
+    radio_cw(true);
+    t0 = getTimeMs() + CW_PREAMBLE_MS;
+    total = sched.count * test_config.send_count;
+
+    for(slot=0; slot<total; slot++){
+        n = slot % sched.count;
+        schedule_step(&sched, n, &testIdx, ant_cfg_p);
+        ant_test_stage(&ant_cfg_p->ant);
+
+        slotStart = t0 + slot * test_config.send_delay;
+        while( (int32_t)(getTimeMs() - slotStart) < 0 );
+
+        ant_test_latch();
+        radio_set_power(ant_cfg_p->power);
+
+        if( fl_test_restart || fl_test_stop ) break;
+    }
+    if( slot >= total ){
+        slotStart = t0 + total * test_config.send_delay;
+        while( (int32_t)(getTimeMs() - slotStart) < 0 );
+    }
+    radio_cw(false);
+
+    // Step 0 of the schedule for test_next_step()
+    schedule_step(&sched, 0, &testIdx, ant_cfg_p);
+    fl_antLatchedValid = false;
+    fl_antStaged = false;
+
+    if( slot < total ){
+        cw->action = MSG_ACT_STOP;
+        cw->seq = ctrl_next_seq();
+        MSG_DO_CHECKSUM( cw_msg );
+        CTRL_SEND_RELIABLE( cw_msg, flAcked );
+    }
+}
+
 // -------------------------------------------------------------------------
 // -------------------------------------------------------------------------
 void test_step()
 {
     int i;
+    uint16_t sendCount;
     uint8_t err;
+    bool flSettle = false;
 
-#ifdef DEBUG_PHASER
+    TRACE(TRACE_STEP, 0);
+#if defined(DEBUG_PHASER) && !defined(TRACE_PHASES)
+    // Stalls the loop on the UART, not with the trace
     PRINTF("Do Send %d\n", (int)ant_cfg_p->expIdx);
 #endif
 
-    set_angle(ant_cfg_p->angle);
+    if( test_config.sweep_mode == SWEEP_MODE_CW ){
+        tx_drain();
+        cw_sweep();
+        return;
+    }
+
+    // The last ping of the previous step must leave the air
+    // before the antenna changes.
+    tx_drain();
+    TRACE(TRACE_DRAIN, 0);
+
+    if( !fl_antLatchedValid && !fl_antStaged ){
+        ant_test_stage(&ant_cfg_p->ant);
+        fl_antStaged = true;
+    }
+    if( fl_antStaged ){
+        ant_test_latch();
+        antLatched = ant_cfg_p->ant;
+        fl_antLatchedValid = true;
+        fl_antStaged = false;
+        flSettle = true;
+    }
+    TRACE(TRACE_ANT_LATCH, 0);
 
-    ant_test_setup(ant_cfg_p);
-    radioSetTxPower(ant_cfg_p->power);
+    // The stepper move takes far longer than the antenna settle time
+    if( set_angle(ant_cfg_p->angle) ) flSettle = false;
 
-    for(i=0; i<test_config.send_count; i++)
+    channel_set(ant_cfg_p->channel);
+#ifdef PING_COMPACT
+    if( fl_anchorPending ) ping_anchor();
+#endif
+    TRACE(TRACE_ANGLE, 0);
+    radio_set_power(ant_cfg_p->power);
+    TRACE(TRACE_POWER, 0);
+    if( flSettle ) ant_test_settle();
+    TRACE(TRACE_SETTLE, 0);
+
+#ifdef TX_PACING_TIMER
+    tx_slot_start();
+#endif
+    fl_expConverged = false;
+    STREAM_STAT_INIT(echoRssi);
+    STREAM_STAT_INIT(echoLqi);
+
+    // The dwell of a TLV config, otherwise send_count
+    sendCount = schedule_dwell(&sched, schedIdx);
+    for(i=0; i<sendCount; i++)
     {
+        // Adaptive mode: stop early when the monitor has enough data
+        if( fl_expConverged && test_config.send_count_min && i >= test_config.send_count_min ){
+            break;
+        }
+
+#ifdef TDMA_SLOTTED
+        // Each ping in the slot of the node, the first one in the next slot
+        tdma_slot_wait(i>0 ? test_config.send_delay : 0);
+        TRACE(TRACE_SLOT, i);
+        if( fl_test_restart || fl_test_stop ) break;
+        while( cc2420IsTxBusy() );
+        TRACE(TRACE_TX_WAIT, i);
+#elif defined(TX_PACING_TIMER)
+        if( i>0 ){
+            tx_slot_wait(test_config.send_delay);
+            if( fl_test_restart || fl_test_stop ) break;
+        }
+        TRACE(TRACE_SLOT, i);
+        // Previous ping must leave the radio before the next one is loaded
+        while( cc2420IsTxBusy() );
+        TRACE(TRACE_TX_WAIT, i);
+#endif
+        // Again for each ping: a control message sent in the slot wait
+        // restores the CCA for itself.
+        tx_measure_cca(false);
+        if( test_config.sweep_mode == SWEEP_MODE_SETTLE ) settle_switch();
+
         ant_cfg_p->timestamp = getTimeMs();
         ant_cfg_p->msgCounter ++;
 
+#ifdef PING_COMPACT
+        if( fl_pingCompact ){
+            compact_msg.payload.expIdx = ant_cfg_p->expIdx;
+            compact_msg.payload.seq = ant_cfg_p->msgCounter;
+            MSG_DO_CHECKSUM( compact_msg );
+            TRACE(TRACE_CHECKSUM, i);
+            err = MSG_RADIO_SEND(compact_msg);
+        }
+        else {
+            MSG_DO_CHECKSUM( ant_msg );
+            TRACE(TRACE_CHECKSUM, i);
+            err = MSG_RADIO_SEND(ant_msg);
+        }
+#else
         MSG_DO_CHECKSUM( ant_msg );
+        TRACE(TRACE_CHECKSUM, i);
         err = MSG_RADIO_SEND(ant_msg);
+#endif
+        TRACE(TRACE_SEND, i);
 
 #ifdef DEBUG_PHASER
         if(err<0){
@@ -384,12 +2169,24 @@ void test_step()
         }
 #endif
 
+#if !defined(TX_PACING_TIMER) && !defined(TDMA_SLOTTED)
         // Wait till send done
         mdelay(1);
         while( cc2420IsTxBusy() );
+        TRACE(TRACE_TX_BUSY, i);
 
         mdelay_var(test_config.send_delay);
+        TRACE(TRACE_DELAY, i);
+#endif
+    }
+    if( test_config.echo && !fl_test_restart && !fl_test_stop ){
+        echo_report(i);
+        TRACE(TRACE_ECHO, 0);
     }
+
+    // The last ping, or the echo report, is left draining from the radio,
+    // while test_next() stages the next antenna state. The next step sets
+    // the ping power again.
 }
 
 // -------------------------------------------------------------------------
@@ -419,16 +2216,40 @@ void appMain(void)
     ledTestFinished();
 
     ant_driver_init();
+#ifdef TX_PACING_TIMER
+    tx_slot_init();
+#endif
 
     radioSetReceiveHandle(onRadioRecv);
     radioOn();
 
+#ifdef STEPPER_WIRED
+    serialInit(STEPPER_LINK_SERIAL_ID, STEPPER_LINK_BAUD, 0);
+    serialSetReceiveHandle(STEPPER_LINK_SERIAL_ID, onLinkRecv);
+    serialEnableRX(STEPPER_LINK_SERIAL_ID);
+#endif
+
+    rto_init(&ctrlRto);
+    ant_cfg_p->nodeId = PH_NODE_ID;
+    result_msg.payload.nodeId = PH_NODE_ID;
+    echo_result_msg.payload.nodeId = PH_NODE_ID;
+
+#ifdef CHECKPOINT_INTERVAL_MS
+    fl_checkpointValid = checkpoint_load(&checkpoint);
+#endif
+
     fl_test_stop = false;  
 
     while(1) 
     {
+        shard_apply();  // New shard assignment, if any
         config_init();  // Init the global configuration list
+        fl_testRunning = true;
     
+#ifdef CHECKPOINT_INTERVAL_MS
+        // A received config is run instead of the checkpoint
+        if( fl_configRun || !test_resume() )
+#endif
         test_init();
         test_start();
         
@@ -442,12 +2263,26 @@ void appMain(void)
             test_step();
             if( ! test_next() ){
                 send_ctrl_msg(MSG_ACT_DONE);
+#ifdef CHECKPOINT_INTERVAL_MS
+                // Campaign complete, nothing to resume
+                checkpoint_clear();
+                fl_checkpointValid = false;
+#endif
                 break;
             }
+            TRACE(TRACE_NEXT, 0);
+#ifdef CHECKPOINT_INTERVAL_MS
+            checkpoint_tick();
+#endif
 
+            ctrl_process_pending();
+#ifdef TRACE_PHASES
+            if( fl_traceDump ) trace_dump();
+#endif
             if( ant_check_button() ) fl_test_restart = true;
         }
         // Test done!
+        fl_testRunning = false;
 
 #ifdef FL_TEST_RESTART_ON_END
         fl_test_restart = true;
@@ -455,6 +2290,10 @@ void appMain(void)
 
         while( !fl_test_restart || fl_test_stop ) 
         {
+            ctrl_process_pending();
+#ifdef TRACE_PHASES
+            if( fl_traceDump ) trace_dump();
+#endif
             ledTestFinished();
             if( ant_check_button() ){
                 fl_test_restart = true;
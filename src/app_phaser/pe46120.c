@@ -0,0 +1,51 @@
+// --------------------------------------------
+// PE46120 dual phase shifter: the serial words and the channel writes.
+// See pe46120.h
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "pe46120.h"
+
+
+#define PE46120_TX4(p, a, c) \
+    PE46120_TX(p, a, c), PE46120_TX((p)+1, a, c), \
+    PE46120_TX((p)+2, a, c), PE46120_TX((p)+3, a, c)
+#define PE46120_TX32(a, c) { \
+    PE46120_TX4(0, a, c),  PE46120_TX4(4, a, c),  PE46120_TX4(8, a, c), \
+    PE46120_TX4(12, a, c), PE46120_TX4(16, a, c), PE46120_TX4(20, a, c), \
+    PE46120_TX4(24, a, c), PE46120_TX4(28, a, c) }
+#define PE46120_TX_ATT(c) { \
+    PE46120_TX32(0, c),  PE46120_TX32(1, c),  PE46120_TX32(2, c),  PE46120_TX32(3, c), \
+    PE46120_TX32(4, c),  PE46120_TX32(5, c),  PE46120_TX32(6, c),  PE46120_TX32(7, c), \
+    PE46120_TX32(8, c),  PE46120_TX32(9, c),  PE46120_TX32(10, c), PE46120_TX32(11, c), \
+    PE46120_TX32(12, c), PE46120_TX32(13, c), PE46120_TX32(14, c), PE46120_TX32(15, c) }
+
+// Ready to send words: [channel][attenuation][phase], 2KB flash
+const uint16_t pe46120_table[2][16][32] = {
+    PE46120_TX_ATT(0),
+    PE46120_TX_ATT(1)
+};
+
+// -------------------------------------------------------------------------
+//  Ready to send serial word for one PE46120 channel
+// -------------------------------------------------------------------------
+uint16_t pe46120_word(uint8_t phase, uint8_t attenuation, uint8_t channel)
+{
+    return pe46120_table[channel & 0x01][attenuation & 0x0f][phase & 0x1f];
+}
+
+// -------------------------------------------------------------------------
+//  Last word written to each channel. A channel is only written when 
+//  its word changes.
+// -------------------------------------------------------------------------
+static uint16_t pe46120Latched[2] = {PE46120_WORD_NONE, PE46120_WORD_NONE};
+
+bool pe46120_write(uint8_t channel, uint16_t word)
+{
+    channel &= 0x01;
+    if( pe46120Latched[channel] == word ) return false;
+    pe46120_send_word(word);
+    pe46120Latched[channel] = word;
+    return true;
+}
@@ -0,0 +1,70 @@
+// --------------------------------------------
+// PE46120 dual phase shifter: the serial words and the channel writes.
+// The pins and the transfer, pe46120_send_word(), are in the driver.
+//
+// Serial map: 
+// 14bit word: S0 S1 P0-P4 M0-M3 S2 S3 C0
+// M0-M3 - attenuation:  4 + 2 + 1 + 0.5 dB
+// P0-P4 - phase shift:  45 + 22.5 + 11.2 + 5.6 + 2.8 deg
+// C0 - channel register select 
+//      Channels: RFOUT1: phase only;  RFOUT2: attenuation and phase
+// S* - spare bits = X
+// --------------------------------------------
+
+#ifndef _pe46120_h_
+#define _pe46120_h_
+
+#include "stdmansos.h"
+
+// Send the serial words with the USART in SPI mode instead of bit-banging.
+// RFCLK and RFSDI must be wired to UCLK and SIMO of the USART; the 
+// P2.3/P2.6 lines are then left as inputs.
+// On the MSP430F1611 of the TelosB, USART0 is the CC2420 SPI and USART1
+// the PRINTF UART. With USART1 the serial output must be off: USE_PRINT=n
+// in config, DEBUG_PHASER commented in main.c.
+// Comment to use the bit-bang transfer.
+// #define PE46120_USE_SPI
+#define PE46120_SPI_BUS  1      // USART1: SIMO P5.1, UCLK P5.3
+
+#if defined(PE46120_USE_SPI) && defined(USE_PRINT) && (PE46120_SPI_BUS == PRINTF_SERIAL_ID)
+#error "PE46120_USE_SPI: the USART is the PRINTF UART, set USE_PRINT=n and comment DEBUG_PHASER"
+#endif
+
+// No word written to the channel yet
+#define PE46120_WORD_NONE  0xffff
+
+// -------------------------------------------------------------------------
+//  Serial words, built at compile time.
+//  PE46120_WORD - the 14-bit word, see the serial map above
+//  PE46120_TX   - the word as the transfer sends it: as is for the 
+//                 bit-bang, SPI frame for the USART (see pe46120_send_word)
+// -------------------------------------------------------------------------
+#define PE46120_WORD(p, a, c) \
+    ( (((p) & 0x1f) << 2) | (((a) & 0x0f) << 7) | (((c) & 0x01) << 13) )
+
+#define PE46120_BIT(w, b, to)  ((((w) >> (b)) & 0x01) << (to))
+#define PE46120_REV14(w) ( \
+    PE46120_BIT(w, 0, 13) | PE46120_BIT(w, 1, 12) | PE46120_BIT(w, 2, 11) | \
+    PE46120_BIT(w, 3, 10) | PE46120_BIT(w, 4, 9)  | PE46120_BIT(w, 5, 8)  | \
+    PE46120_BIT(w, 6, 7)  | PE46120_BIT(w, 7, 6)  | PE46120_BIT(w, 8, 5)  | \
+    PE46120_BIT(w, 9, 4)  | PE46120_BIT(w, 10, 3) | PE46120_BIT(w, 11, 2) | \
+    PE46120_BIT(w, 12, 1) | PE46120_BIT(w, 13, 0) )
+
+#ifdef PE46120_USE_SPI
+#define PE46120_TX(p, a, c)  PE46120_REV14(PE46120_WORD(p, a, c))
+#else
+#define PE46120_TX(p, a, c)  PE46120_WORD(p, a, c)
+#endif
+
+
+// Ready to send serial word for one channel
+uint16_t pe46120_word(uint8_t phase, uint8_t attenuation, uint8_t channel);
+
+// Send the word to the channel, only if it is not the last one written.
+// Return true if sent.
+bool pe46120_write(uint8_t channel, uint16_t word);
+
+// Send a serial word and latch it. In the driver.
+void pe46120_send_word(uint16_t frame);
+
+#endif // _pe46120_h_
@@ -0,0 +1,55 @@
+// --------------------------------------------
+// Adaptive retransmission timeout for the reliable control messages.
+// See rto.h
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "rto.h"
+
+
+static uint16_t rto_clamp(uint32_t rto)
+{
+    if( rto < RTO_MIN_MS ) return RTO_MIN_MS;
+    if( rto > RTO_MAX_MS ) return RTO_MAX_MS;
+    return rto;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+void rto_init(rto_t *r)
+{
+    r->srtt8 = 0;
+    r->rttvar4 = 0;
+    r->rto = RTO_INITIAL_MS;
+    r->flSampled = false;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+void rto_sample(rto_t *r, uint16_t rttMs)
+{
+    int16_t delta;
+
+    if( rttMs > RTO_MAX_MS ) rttMs = RTO_MAX_MS;
+
+    if( !r->flSampled ){
+        r->srtt8 = rttMs << 3;
+        r->rttvar4 = rttMs << 1;    // rttvar = rtt/2
+        r->flSampled = true;
+    }
+    else {
+        delta = rttMs - (r->srtt8 >> 3);
+        r->srtt8 += delta;
+        if( delta < 0 ) delta = -delta;
+        r->rttvar4 += delta - (r->rttvar4 >> 2);
+    }
+    r->rto = rto_clamp( (r->srtt8 >> 3) + r->rttvar4 );
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+void rto_backoff(rto_t *r)
+{
+    r->rto = rto_clamp( (uint32_t)r->rto * 2 );
+}
@@ -0,0 +1,37 @@
+// --------------------------------------------
+// Adaptive retransmission timeout for the reliable control messages.
+//
+// Smoothed round trip time and its variation, as in TCP (RFC 6298):
+//   srtt = 7/8 srtt + 1/8 rtt,  rttvar = 3/4 rttvar + 1/4 |srtt - rtt|
+//   rto = srtt + 4 rttvar
+// Kept scaled (srtt*8, rttvar*4) in integer ms. The timeout is doubled
+// on each retransmission; retransmitted messages give no RTT samples.
+// --------------------------------------------
+
+#ifndef _rto_h_
+#define _rto_h_
+
+#include "stdmansos.h"
+
+#define RTO_INITIAL_MS  100
+#define RTO_MIN_MS      10
+#define RTO_MAX_MS      400
+
+typedef struct
+{
+    uint16_t srtt8;         // Smoothed RTT, 1/8 ms
+    uint16_t rttvar4;       // RTT variation, 1/4 ms
+    uint16_t rto;           // Current timeout, ms
+    bool flSampled;         // At least one RTT sample
+} rto_t;
+
+
+void rto_init(rto_t *r);
+
+// RTT of a message ACKed on the first send, ms
+void rto_sample(rto_t *r, uint16_t rttMs);
+
+// No ACK within the timeout
+void rto_backoff(rto_t *r);
+
+#endif // _rto_h_
@@ -0,0 +1,271 @@
+// --------------------------------------------
+// Sweep schedule of one test configuration.
+// See schedule.h
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "../phaser_msg.h"
+
+#include "antenna_driver.h"
+#include "schedule.h"
+
+
+// -------------------------------------------------------------------------
+// Dimension from the config fields
+// -------------------------------------------------------------------------
+static void dim_from_config(schedule_t *sched, uint8_t kind)
+{
+    const test_config_t *cfg = sched->cfg;
+    sweep_dim_t *d = &(sched->dim[sched->dimCount++]);
+    uint16_t countA, countB, n;
+
+    d->kind = kind;
+    d->values = SWEEP_VAL_RANGE;
+    d->start = 0;
+    d->step = 1;
+
+    switch( kind ){
+    case SWEEP_DIM_POWER:
+        // Power list ends at the first zero, but the first entry is always used
+        for(n=1; n<TEST_CONFIG_POWER_LIST_SIZE && cfg->power[n] > 0; n++);
+        d->values = SWEEP_VAL_POWER;
+        d->count = n;
+        break;
+    case SWEEP_DIM_ANT_A:
+    case SWEEP_DIM_ANT_B:
+        ant_test_dims(cfg, &countA, &countB);
+        n = (kind == SWEEP_DIM_ANT_A) ? countA : countB;
+        d->count = n ? n : 1;
+        break;
+    case SWEEP_DIM_CHANNEL:
+        d->start = schedule_channel(cfg, 0);
+        d->step = cfg->channel.step;
+        d->count = cfg->channel.count ? cfg->channel.count : 1;
+        break;
+    }
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+void schedule_init(schedule_t *sched, const test_config_t *cfg, const sweep_spec_t *spec)
+{
+    uint16_t order, used = 0;
+    uint8_t i, kind;
+
+    sched->cfg = cfg;
+    sched->spec = spec;
+    sched->dimCount = 0;
+
+    if( spec && spec->dimCount ){
+        memcpy(sched->dim, spec->dim, spec->dimCount * sizeof(sweep_dim_t));
+        sched->dimCount = spec->dimCount;
+    }
+    else {
+        // The dwell comes from the TLV config only
+        order = cfg->dim_order;
+        while( (kind = order & 0xf) ){
+            order >>= 4;
+            if( kind >= SWEEP_DIM_DWELL || (used & (1 << kind)) ) continue;
+            used |= 1 << kind;
+            dim_from_config(sched, kind);
+        }
+        for(kind=SWEEP_DIM_POWER; kind<SWEEP_DIM_DWELL; kind++){
+            if( !(used & (1 << kind)) ) dim_from_config(sched, kind);
+        }
+    }
+
+    sched->countPower = sched->countA = sched->countB = sched->countChannel = 1;
+    sched->count = 1;
+    for(i=0; i<sched->dimCount; i++){
+        switch( sched->dim[i].kind ){
+        case SWEEP_DIM_POWER:   sched->countPower = sched->dim[i].count; break;
+        case SWEEP_DIM_ANT_A:   sched->countA = sched->dim[i].count; break;
+        case SWEEP_DIM_ANT_B:   sched->countB = sched->dim[i].count; break;
+        case SWEEP_DIM_CHANNEL: sched->countChannel = sched->dim[i].count; break;
+        }
+        sched->count *= sched->dim[i].count;
+    }
+}
+
+// -------------------------------------------------------------------------
+// Value k of the dimension
+// -------------------------------------------------------------------------
+static uint16_t dim_value(const schedule_t *sched, const sweep_dim_t *d, uint16_t k)
+{
+    switch( d->values ){
+    case SWEEP_VAL_LIST:
+        return sched->spec->list[d->start + k];
+    case SWEEP_VAL_POWER:
+        return sched->cfg->power[k];
+    }
+    return d->start + k * d->step;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+bool schedule_check(const test_config_t *cfg, const sweep_spec_t *spec)
+{
+    schedule_t s;
+    const sweep_dim_t *d;
+    ant_state_t ant;
+    uint16_t countA, countB, k, v, used = 0;
+    uint32_t count = 1;
+    uint16_t usedEl = 0;
+    uint8_t i, el;
+
+    if( spec->dimCount > SWEEP_DIM_MAX ) return false;
+    ant_test_dims(cfg, &countA, &countB);
+    if( countA == 0 ) countA = 1;
+    if( countB == 0 ) countB = 1;
+    // The element vector format of the driver
+    ant_test_state(cfg, 0, 0, &ant);
+
+    s.cfg = cfg;
+    s.spec = spec;
+    for(i=0; i<spec->dimCount; i++){
+        d = &(spec->dim[i]);
+        if( SWEEP_DIM_IS_ELEMENT(d->kind) ){
+            el = d->kind - SWEEP_DIM_ELEMENT;
+            if( el >= ANT_FORMAT_ELEMENTS(ant.format) ) return false;
+            if( usedEl & (1 << el) ) return false;
+            usedEl |= 1 << el;
+        }
+        else {
+            if( d->kind < SWEEP_DIM_POWER || d->kind >= SWEEP_DIM_KINDS ) return false;
+            if( used & (1 << d->kind) ) return false;
+            used |= 1 << d->kind;
+        }
+
+        if( d->count == 0 ) return false;
+        if( d->values == SWEEP_VAL_LIST ){
+            if( (uint32_t)d->start + d->count > SWEEP_LIST_MAX ) return false;
+        }
+        else if( d->values != SWEEP_VAL_RANGE ) return false;
+
+        count *= d->count;
+        if( count > 0xffffff ) return false;
+
+        for(k=0; k<d->count; k++){
+            v = dim_value(&s, d, k);
+            switch( d->kind ){
+            case SWEEP_DIM_POWER:
+                if( v > 31 ) return false;
+                break;
+            case SWEEP_DIM_ANT_A:
+                if( v >= countA ) return false;
+                break;
+            case SWEEP_DIM_ANT_B:
+                if( v >= countB ) return false;
+                break;
+            case SWEEP_DIM_CHANNEL:
+                if( v < PH_CHANNEL_MIN || v > PH_CHANNEL_MAX ) return false;
+                break;
+            case SWEEP_DIM_DWELL:
+                if( v == 0 ) return false;
+                break;
+            default:    // Element
+                if( v > ANT_EL_MASK(ANT_FORMAT_BITS(ant.format)) ) return false;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// Gray order changes one bit of the index per step, so the phase words
+// (start + k*step, step a power of two) flip one shifter bit at a time.
+// Only for dimensions of size 2^n, others stay in the linear order.
+// -------------------------------------------------------------------------
+uint16_t schedule_order(uint16_t k, uint16_t count, uint8_t order)
+{
+    if( order == SWEEP_ORDER_GRAY && (count & (count - 1)) == 0 ){
+        return k ^ (k >> 1);
+    }
+    return k;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+uint8_t schedule_channel(const test_config_t *cfg, uint16_t k)
+{
+    if( cfg->channel.count == 0 ) return PH_CHANNEL_HOME;
+    return cfg->channel.start + k * cfg->channel.step;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+void schedule_step(const schedule_t *sched, uint32_t n, test_loop_t *idx, phaser_ping_t *ping)
+{
+    const test_config_t *cfg = sched->cfg;
+    const sweep_dim_t *d;
+    uint16_t k, kA = 0, kB = 0;
+    uint16_t elVal[SWEEP_DIM_MAX];
+    uint8_t i, bits;
+
+    idx->power.idx = idx->phaseA.idx = idx->phaseB.idx = idx->channel.idx = 0;
+    idx->power.limit = sched->countPower;
+    idx->phaseA.limit = sched->countA;
+    idx->phaseB.limit = sched->countB;
+    idx->channel.limit = sched->countChannel;
+
+    // Values of the dimensions not swept
+    ping->power = cfg->power[0];
+    ping->channel = PH_CHANNEL_HOME;
+
+    for(i=0; i<sched->dimCount; i++){
+        d = &(sched->dim[i]);
+        k = n % d->count;
+        n /= d->count;
+
+        switch( d->kind ){
+        case SWEEP_DIM_POWER:
+            idx->power.idx = k;
+            ping->power = dim_value(sched, d, k);
+            break;
+        case SWEEP_DIM_ANT_A:
+            idx->phaseA.idx = k;
+            if( d->values == SWEEP_VAL_RANGE ) k = schedule_order(k, d->count, cfg->ant_order);
+            kA = dim_value(sched, d, k);
+            break;
+        case SWEEP_DIM_ANT_B:
+            idx->phaseB.idx = k;
+            if( d->values == SWEEP_VAL_RANGE ) k = schedule_order(k, d->count, cfg->ant_order);
+            kB = dim_value(sched, d, k);
+            break;
+        case SWEEP_DIM_CHANNEL:
+            idx->channel.idx = k;
+            ping->channel = dim_value(sched, d, k);
+            break;
+        default:
+            if( SWEEP_DIM_IS_ELEMENT(d->kind) ) elVal[i] = dim_value(sched, d, k);
+            break;
+        }
+    }
+    ant_test_state(cfg, kA, kB, &ping->ant);
+
+    // The swept elements over the driver state
+    bits = ANT_FORMAT_BITS(ping->ant.format);
+    for(i=0; i<sched->dimCount; i++){
+        d = &(sched->dim[i]);
+        if( SWEEP_DIM_IS_ELEMENT(d->kind) ){
+            ANT_EL_SET(&ping->ant, d->kind - SWEEP_DIM_ELEMENT, bits, elVal[i]);
+        }
+    }
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+uint16_t schedule_dwell(const schedule_t *sched, uint32_t n)
+{
+    const sweep_dim_t *d;
+    uint8_t i;
+
+    for(i=0; i<sched->dimCount; i++){
+        d = &(sched->dim[i]);
+        if( d->kind == SWEEP_DIM_DWELL ) return dim_value(sched, d, n % d->count);
+        n /= d->count;
+    }
+    return sched->cfg->send_count;
+}
@@ -0,0 +1,53 @@
+// --------------------------------------------
+// Sweep schedule of one test configuration.
+//
+// Step N of the sweep (power, antenna state, channel, dwell) is decoded
+// directly from the configuration, without iterating over the previous
+// steps. The step index is a mixed radix number over the sweep
+// dimensions, innermost first. By default power is the innermost one,
+// then the two antenna dimensions, then the radio channel: a hop takes
+// a message exchange with the monitor. See SWEEP_DIM_* in phaser_msg.h.
+// --------------------------------------------
+
+#ifndef _schedule_h_
+#define _schedule_h_
+
+#include "stdmansos.h"
+
+#include "../phaser_msg.h"
+
+typedef struct
+{
+    const test_config_t *cfg;
+    const sweep_spec_t *spec;   // List values of the dimensions, or NULL
+    uint8_t dimCount;
+    sweep_dim_t dim[SWEEP_DIM_MAX];     // Innermost first
+    uint16_t countPower;        // Dimension sizes by kind, 1: not swept
+    uint16_t countA;
+    uint16_t countB;
+    uint16_t countChannel;
+    uint32_t count;     // Steps per angle
+} schedule_t;
+
+
+// Dimensions of the configuration: from the spec, if it has any,
+// otherwise from the config fields. spec may be NULL.
+void schedule_init(schedule_t *sched, const test_config_t *cfg, const sweep_spec_t *spec);
+
+// Check the spec dimensions against the config. Return true if valid.
+bool schedule_check(const test_config_t *cfg, const sweep_spec_t *spec);
+
+// Decode step n (0 .. count-1): set the iterator indexes,
+// the TX power, the antenna state and the channel of the ping.
+void schedule_step(const schedule_t *sched, uint32_t n, test_loop_t *idx, phaser_ping_t *ping);
+
+// Pings of step n: the dwell dimension, or send_count
+uint16_t schedule_dwell(const schedule_t *sched, uint32_t n);
+
+// Position of the k-th visited value in a dimension of the given size
+uint16_t schedule_order(uint16_t k, uint16_t count, uint8_t order);
+
+// Channel of the k-th value of the channel sweep
+uint8_t schedule_channel(const test_config_t *cfg, uint16_t k);
+
+#endif // _schedule_h_
@@ -0,0 +1,105 @@
+// --------------------------------------------
+// Coarse-to-fine search of the best antenna state at one angle.
+// See search.h
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "search.h"
+
+
+// Neighbours at the refine level: -A, +A, -B, +B
+#define NEIGHBOUR_COUNT 4
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+void search_start(search_t *s, uint16_t countA, uint16_t countB, uint8_t coarse,
+    uint16_t *kA, uint16_t *kB)
+{
+    s->countA = countA ? countA : 1;
+    s->countB = countB ? countB : 1;
+
+    // Grid stride of each dimension, coarse points in both
+    if( coarse == 0 ) coarse = 1;
+    s->strideA = s->countA / coarse;
+    if( s->strideA == 0 ) s->strideA = 1;
+    s->strideB = s->countB / coarse;
+    if( s->strideB == 0 ) s->strideB = 1;
+
+    s->curA = s->curB = 0;
+    s->bestA = s->bestB = 0;
+    s->bestRssi = 0;
+    s->flBest = false;
+    s->flGrid = true;
+    s->neighbour = 0;
+    s->steps = 0;
+
+    *kA = 0;
+    *kB = 0;
+}
+
+// -------------------------------------------------------------------------
+// Next neighbour of the best point at the current strides.
+// Return false when all neighbours are done.
+// -------------------------------------------------------------------------
+static bool next_neighbour(search_t *s)
+{
+    int32_t a, b;
+
+    while( s->neighbour < NEIGHBOUR_COUNT ){
+        a = s->bestA;
+        b = s->bestB;
+        switch( s->neighbour++ ){
+        case 0: a -= s->strideA; break;
+        case 1: a += s->strideA; break;
+        case 2: b -= s->strideB; break;
+        case 3: b += s->strideB; break;
+        }
+        if( a < 0 || a >= s->countA || b < 0 || b >= s->countB ) continue;
+        s->curA = a;
+        s->curB = b;
+        return true;
+    }
+    return false;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+bool search_next(search_t *s, int16_t rssi, bool valid, uint16_t *kA, uint16_t *kB)
+{
+    s->steps++;
+    if( valid && (!s->flBest || rssi > s->bestRssi) ){
+        s->bestRssi = rssi;
+        s->bestA = s->curA;
+        s->bestB = s->curB;
+        s->flBest = true;
+    }
+
+    if( s->flGrid ){
+        // Next grid point, A is the inner dimension
+        s->curA += s->strideA;
+        if( s->curA >= s->countA ){
+            s->curA = 0;
+            s->curB += s->strideB;
+        }
+        if( s->curB < s->countB ){
+            *kA = s->curA;
+            *kB = s->curB;
+            return true;
+        }
+        s->flGrid = false;
+        s->neighbour = NEIGHBOUR_COUNT;     // Start the first refine level
+    }
+
+    // Refine around the best point with halving strides. Rounded up: the
+    // peak past the last grid point may be a stride away from it.
+    while( !next_neighbour(s) ){
+        if( s->strideA <= 1 && s->strideB <= 1 ) return false;
+        if( s->strideA > 1 ) s->strideA = (s->strideA + 1) / 2;
+        if( s->strideB > 1 ) s->strideB = (s->strideB + 1) / 2;
+        s->neighbour = 0;
+    }
+    *kA = s->curA;
+    *kB = s->curB;
+    return true;
+}
@@ -0,0 +1,41 @@
+// --------------------------------------------
+// Coarse-to-fine search of the best antenna state at one angle.
+//
+// The two antenna dimensions are first sampled on a coarse grid.
+// Then the strides are halved, rounded up, at each level and the neighbours
+// of the best point so far are tried, until both strides are 1 (pattern
+// search).
+// Positions are value positions kA, kB of the dimensions, see schedule.h
+// --------------------------------------------
+
+#ifndef _search_h_
+#define _search_h_
+
+#include "stdmansos.h"
+
+typedef struct
+{
+    uint16_t countA;
+    uint16_t countB;
+    uint16_t strideA;           // Grid stride in each dimension
+    uint16_t strideB;
+    uint16_t curA, curB;        // Point being measured
+    uint16_t bestA, bestB;      // Best point so far
+    int16_t bestRssi;
+    bool flBest;                // Best point is set
+    bool flGrid;                // Coarse grid level
+    uint8_t neighbour;          // Next neighbour to try at the refine level
+    uint16_t steps;             // Points measured
+} search_t;
+
+
+// Start the search. coarse - grid points per dimension.
+// Set the first point to measure.
+void search_start(search_t *s, uint16_t countA, uint16_t countB, uint8_t coarse,
+    uint16_t *kA, uint16_t *kB);
+
+// Record the RSSI of the current point (valid=false if not measured)
+// and set the next point. Return false when the search is done.
+bool search_next(search_t *s, int16_t rssi, bool valid, uint16_t *kA, uint16_t *kB);
+
+#endif // _search_h_
@@ -0,0 +1,57 @@
+// --------------------------------------------
+// Settle time calibration of the antenna driver.
+// See settle.h
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "settle.h"
+
+
+// Candidate delays, us. The first one is the reference.
+static const uint16_t settleDelays[] = {
+    SETTLE_REF_US, 2000, 1000, 500, 200, 100, 50, 20, 0
+};
+#define SETTLE_DELAY_COUNT (sizeof(settleDelays)/sizeof(settleDelays[0]))
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+void settle_start(settle_t *s, uint8_t tol, uint16_t *delayUs, uint8_t *end)
+{
+    s->cand = 0;
+    s->end = 0;
+    s->ref[0] = s->ref[1] = 0;
+    s->tol = tol;
+    s->bestUs = SETTLE_NONE;
+
+    *delayUs = settleDelays[0];
+    *end = 0;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+bool settle_next(settle_t *s, int16_t rssi, bool valid, uint16_t *delayUs, uint8_t *end)
+{
+    int16_t diff;
+
+    if( !valid ) return false;      // No data, keep the last delay passed
+
+    if( s->cand == 0 ){
+        s->ref[s->end] = rssi;
+        if( s->end ) s->bestUs = settleDelays[0];
+    }
+    else {
+        diff = rssi - s->ref[s->end];
+        if( diff < 0 ) diff = -diff;
+        if( diff > s->tol ) return false;
+        // Both states must pass
+        if( s->end ) s->bestUs = settleDelays[s->cand];
+    }
+
+    s->end ^= 1;
+    if( s->end == 0 && ++s->cand >= SETTLE_DELAY_COUNT ) return false;
+
+    *delayUs = settleDelays[s->cand];
+    *end = s->end;
+    return true;
+}
@@ -0,0 +1,42 @@
+// --------------------------------------------
+// Settle time calibration of the antenna driver.
+//
+// The antenna is switched between its two extreme states before every
+// ping, and the ping is sent a candidate delay after the switch.
+// Candidate delays go down from a long reference delay. The RSSI mean of
+// each candidate, for both states, is compared to the reference one; the
+// shortest delay before the first candidate off by more than the
+// tolerance is the settle time.
+// --------------------------------------------
+
+#ifndef _settle_h_
+#define _settle_h_
+
+#include "stdmansos.h"
+
+// Reference delay: the state is assumed settled, us
+#define SETTLE_REF_US   5000
+
+// No settle time found (no reference measurement)
+#define SETTLE_NONE     0xffff
+
+typedef struct
+{
+    uint8_t cand;           // Candidate delay being measured, 0: reference
+    uint8_t end;            // State being measured: 0 - first, 1 - last
+    int16_t ref[2];         // Reference RSSI mean of the states, 1/4 dB
+    uint8_t tol;            // Max offset from the reference, 1/4 dB
+    uint16_t bestUs;        // Shortest delay passed so far
+} settle_t;
+
+
+// Start the calibration. tol - RSSI tolerance, 1/4 dB.
+// Set the first state and delay to measure.
+void settle_start(settle_t *s, uint8_t tol, uint16_t *delayUs, uint8_t *end);
+
+// Record the RSSI mean of the current state and delay (valid=false if not
+// measured) and set the next ones. Return false when done; the settle time
+// is then in bestUs.
+bool settle_next(settle_t *s, int16_t rssi, bool valid, uint16_t *delayUs, uint8_t *end);
+
+#endif // _settle_h_
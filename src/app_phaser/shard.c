@@ -0,0 +1,105 @@
+// --------------------------------------------
+// Sharded campaign: a rig runs a part of the testSet[] sweep.
+// See shard.h
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "../phaser_msg.h"
+
+#include "schedule.h"
+#include "shard.h"
+
+
+// -------------------------------------------------------------------------
+// Experiments of one entry. The sequential run visits at least one angle.
+// -------------------------------------------------------------------------
+static uint32_t entry_size(const test_config_t *cfg, uint32_t *steps)
+{
+    schedule_t s;
+
+    schedule_init(&s, cfg, NULL);
+    *steps = s.count;
+    return s.count * (cfg->angle_count ? cfg->angle_count : 1);
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+uint32_t shard_total(const test_config_t *set, size_t size)
+{
+    uint32_t total = 0, steps;
+    size_t i;
+
+    for(i=0; i<size; i++) total += entry_size(&set[i], &steps);
+    return total;
+}
+
+// -------------------------------------------------------------------------
+// Start of the contiguous shard idx of count: total * idx / count,
+// without the 64-bit product. The remainder term is below 255 * 255.
+// -------------------------------------------------------------------------
+static uint32_t shard_bound(uint32_t total, uint8_t idx, uint8_t count)
+{
+    return total / count * idx + (total % count) * idx / count;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+bool shard_init(shard_t *sh, const test_config_t *set, size_t size,
+    uint8_t idx, uint8_t count, uint8_t mode)
+{
+    uint32_t total;
+    size_t i;
+
+    sh->active = false;
+    if( count == 0 || idx >= count ) return false;
+
+    // Other modes have no fixed step count
+    for(i=0; i<size; i++){
+        if( set[i].sweep_mode != SWEEP_MODE_FULL ) return false;
+    }
+
+    total = shard_total(set, size);
+    if( mode == SHARD_MODE_STRIDE ){
+        sh->cur = idx;
+        sh->end = total;
+        sh->stride = count;
+    }
+    else {
+        sh->cur = shard_bound(total, idx, count);
+        sh->end = shard_bound(total, idx + 1, count);
+        sh->stride = 1;
+    }
+    if( sh->cur >= sh->end ) return false;
+
+    sh->active = true;
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+void shard_locate(const test_config_t *set, size_t size, uint32_t g,
+    uint8_t *entry, uint16_t *angleNum, uint32_t *step)
+{
+    uint32_t n, steps;
+    size_t i;
+
+    for(i=0; i+1<size; i++){
+        n = entry_size(&set[i], &steps);
+        if( g < n ) break;
+        g -= n;
+    }
+    entry_size(&set[i], &steps);
+
+    *entry = i;
+    *angleNum = g / steps;
+    *step = g % steps;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+bool shard_next(shard_t *sh)
+{
+    sh->cur += sh->stride;
+    return sh->cur < sh->end;
+}
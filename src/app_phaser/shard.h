@@ -0,0 +1,44 @@
+// --------------------------------------------
+// Sharded campaign: a rig runs a part of the testSet[] sweep.
+//
+// The global experiment index enumerates the sequential campaign:
+// testSet[] entries in order, then the angles, then the schedule steps.
+// Each index maps directly to (entry, angle number, step), and the
+// experiment index within the entry is the one of the sequential run, so
+// the results of the rigs merge on (configIdx, expIdx).
+// A shard is a contiguous range of the indexes (fewest stepper moves),
+// or every count-th index.
+// --------------------------------------------
+
+#ifndef _shard_h_
+#define _shard_h_
+
+#include "stdmansos.h"
+
+#include "../phaser_msg.h"
+
+typedef struct
+{
+    uint32_t cur;       // Global index of the current experiment
+    uint32_t end;       // Past the last one of the shard
+    uint8_t stride;
+    bool active;        // false: the whole campaign, not sharded
+} shard_t;
+
+
+// Experiments of the campaign
+uint32_t shard_total(const test_config_t *set, size_t size);
+
+// Set up shard idx of count, SHARD_MODE_*.
+// Return false if the set can not be sharded, or the shard is empty.
+bool shard_init(shard_t *sh, const test_config_t *set, size_t size,
+    uint8_t idx, uint8_t count, uint8_t mode);
+
+// Entry, angle number and schedule step of the global index
+void shard_locate(const test_config_t *set, size_t size, uint32_t g,
+    uint8_t *entry, uint16_t *angleNum, uint32_t *step);
+
+// Next experiment of the shard. Return false when done.
+bool shard_next(shard_t *sh);
+
+#endif // _shard_h_
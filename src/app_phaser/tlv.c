@@ -0,0 +1,172 @@
+// --------------------------------------------
+// TLV test configuration.
+// See tlv.h
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "../phaser_msg.h"
+
+#include "tlv.h"
+
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+uint16_t tlv_rx_chunk(tlv_rx_t *rx, const phaser_tlv_chunk_t *chunk, uint32_t now)
+{
+    if( chunk->count == 0 || chunk->count > PH_TLV_CHUNK_COUNT ) return 0;
+    if( chunk->idx >= chunk->count || chunk->len > PH_TLV_CHUNK ) return 0;
+
+    if( chunk->xfer != rx->xfer || chunk->count != rx->count ){
+        rx->xfer = chunk->xfer;
+        rx->count = chunk->count;
+        rx->got = 0;
+        rx->len = 0;
+    }
+    // Only the last chunk may be short
+    if( chunk->idx + 1 < chunk->count && chunk->len != PH_TLV_CHUNK ) return 0;
+
+    memcpy(rx->buf + chunk->idx * PH_TLV_CHUNK, chunk->data, chunk->len);
+    if( chunk->idx + 1 == chunk->count ){
+        rx->len = chunk->idx * PH_TLV_CHUNK + chunk->len;
+    }
+    rx->got |= 1 << chunk->idx;
+    rx->lastMs = now;
+
+    if( rx->got != (1 << rx->count) - 1 ) return 0;
+    // Done, a repeated chunk starts over
+    rx->got = 0;
+    return rx->len;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+bool tlv_rx_expired(tlv_rx_t *rx, uint32_t now)
+{
+    if( rx->got == 0 || now - rx->lastMs < TLV_RX_TIMEOUT_MS ) return false;
+    rx->got = 0;
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// Little endian values
+// -------------------------------------------------------------------------
+static uint16_t get16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static void get_iter8(const uint8_t *p, iter8_config_t *it)
+{
+    it->start = p[0];
+    it->step = p[1];
+    it->count = get16(p + 2);
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+static bool add_dim(sweep_spec_t *spec, uint8_t type, const uint8_t *v, uint8_t len, uint8_t *listUsed)
+{
+    sweep_dim_t *d;
+    uint8_t i, n;
+
+    if( len < 1 || spec->dimCount >= SWEEP_DIM_MAX ) return false;
+    d = &(spec->dim[spec->dimCount++]);
+    d->kind = v[0];
+
+    if( type == TLV_DIM_RANGE ){
+        if( len != 7 ) return false;
+        d->values = SWEEP_VAL_RANGE;
+        d->start = get16(v + 1);
+        d->step = get16(v + 3);
+        d->count = get16(v + 5);
+        return true;
+    }
+
+    n = (len - 1) / 2;
+    if( (len - 1) & 1 || *listUsed + n > SWEEP_LIST_MAX ) return false;
+    d->values = SWEEP_VAL_LIST;
+    d->start = *listUsed;
+    d->step = 1;
+    d->count = n;
+    for(i=0; i<n; i++) spec->list[(*listUsed)++] = get16(v + 1 + 2*i);
+    return true;
+}
+
+// -------------------------------------------------------------------------
+// Records are checked for length here, values in config_check()
+// -------------------------------------------------------------------------
+bool tlv_parse(const uint8_t *buf, uint16_t len, test_config_t *cfg, sweep_spec_t *spec)
+{
+    const uint8_t *v;
+    uint8_t type, l, listUsed = 0;
+    uint16_t pos = 0;
+
+    spec->dimCount = 0;
+
+    while( pos < len ){
+        if( pos + 2 > len ) return false;
+        type = buf[pos];
+        l = buf[pos + 1];
+        v = buf + pos + 2;
+        pos += 2 + l;
+        if( pos > len ) return false;
+
+        switch( type ){
+        case TLV_START_DELAY:
+            if( l != 2 ) return false;
+            cfg->start_delay = get16(v);
+            break;
+        case TLV_SEND_DELAY:
+            if( l != 2 ) return false;
+            cfg->send_delay = get16(v);
+            break;
+        case TLV_SEND_COUNT:
+            if( l != 2 ) return false;
+            cfg->send_count = get16(v);
+            break;
+        case TLV_ANGLE:
+            if( l != 4 ) return false;
+            cfg->angle_step = get16(v);
+            cfg->angle_count = get16(v + 2);
+            break;
+        case TLV_ANT_A:
+            if( l != 4 ) return false;
+            get_iter8(v, &cfg->ant.phaseA);
+            break;
+        case TLV_ANT_B:
+            if( l != 4 ) return false;
+            get_iter8(v, &cfg->ant.phaseB);
+            break;
+        case TLV_ANT_ORDER:
+            if( l != 1 ) return false;
+            cfg->ant_order = v[0];
+            break;
+        case TLV_ANT_ENCODING:
+            if( l != 1 ) return false;
+            cfg->ant_encoding = v[0];
+            break;
+        case TLV_SWEEP_MODE:
+            if( l != 1 ) return false;
+            cfg->sweep_mode = v[0];
+            break;
+        case TLV_ADAPTIVE:
+            if( l != 3 ) return false;
+            cfg->send_count_min = get16(v);
+            cfg->converge_ci = v[2];
+            break;
+        case TLV_ECHO:
+            if( l != 1 ) return false;
+            cfg->echo = v[0];
+            break;
+        case TLV_DIM_RANGE:
+        case TLV_DIM_LIST:
+            if( !add_dim(spec, type, v, l, &listUsed) ) return false;
+            break;
+        default:
+            // Newer setting, not known here
+            break;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+// --------------------------------------------
+// TLV test configuration: reassembly of the PH_MSG_ConfigTlv chunks
+// and parsing of the records, see TLV_* in phaser_msg.h.
+//
+// A new setting is a new record type; older phasers skip it, so the
+// config layout of the messages does not change with each new feature.
+// --------------------------------------------
+
+#ifndef _tlv_h_
+#define _tlv_h_
+
+#include "stdmansos.h"
+
+#include "../phaser_msg.h"
+
+// An incomplete transfer is dropped after this long without a chunk.
+// The monitor sends the chunks TLV_CHUNK_DELAY_MS apart.
+#define TLV_RX_TIMEOUT_MS   500
+
+typedef struct
+{
+    uint8_t xfer;       // Transfer being received
+    uint8_t count;      // Its chunks
+    uint8_t got;        // Bitmask of the chunks received
+    uint16_t len;       // Total length, known with the last chunk
+    uint32_t lastMs;    // Time of the last chunk
+    uint8_t buf[PH_TLV_MAX];
+} tlv_rx_t;
+
+
+// Add the chunk, received at time now, to the transfer. A new transfer
+// ID drops the previous one.
+// Return the config length when all the chunks are in, otherwise 0.
+uint16_t tlv_rx_chunk(tlv_rx_t *rx, const phaser_tlv_chunk_t *chunk, uint32_t now);
+
+// Drop the transfer if chunks are missing TLV_RX_TIMEOUT_MS after the
+// last one. Return true if it was dropped.
+bool tlv_rx_expired(tlv_rx_t *rx, uint32_t now);
+
+// Apply the records to cfg and set the sweep dimensions of spec.
+// Return false if the records are malformed.
+bool tlv_parse(const uint8_t *buf, uint16_t len, test_config_t *cfg, sweep_spec_t *spec);
+
+#endif // _tlv_h_
@@ -0,0 +1,33 @@
+// --------------------------------------------
+// Timing trace of the test loop.
+// See trace.h
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "../phaser_msg.h"
+
+#include "trace.h"
+
+
+trace_entry_t traceBuf[TRACE_SIZE];
+uint16_t traceHead = 0;
+uint16_t traceCount = 0;
+uint16_t traceLost = 0;
+
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+const trace_entry_t *trace_get(uint16_t n)
+{
+    return &(traceBuf[(traceHead - traceCount + n) & (TRACE_SIZE - 1)]);
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+void trace_reset()
+{
+    traceHead = 0;
+    traceCount = 0;
+    traceLost = 0;
+}
@@ -0,0 +1,63 @@
+// --------------------------------------------
+// Timing trace of the test loop, in a RAM ring buffer.
+//
+// trace_mark() stores the free running timer counter and the phase that
+// just ended, a few CPU cycles, no output. The buffer is dumped to the
+// monitor on request (PH_MSG_Trace) and src/tools/trace_hist.py turns
+// the dump into per-phase latency histograms.
+//
+// The default clock is Timer A, which runs the MansOS alarms from the
+// 32768 Hz ACLK: ~30 us resolution, wraps in 2 s. For a finer one, point
+// TRACE_TIMER at a counter clocked from SMCLK, and set TRACE_TICK_HZ.
+// --------------------------------------------
+
+#ifndef _trace_h_
+#define _trace_h_
+
+#include "stdmansos.h"
+
+#include "../phaser_msg.h"
+
+#ifndef TRACE_TIMER
+#define TRACE_TIMER     TAR
+#define TRACE_TICK_HZ   32768ul
+#endif
+
+// Entries, a power of 2. 4 bytes each.
+#define TRACE_SIZE      128
+
+extern trace_entry_t traceBuf[TRACE_SIZE];
+extern uint16_t traceHead;      // Next entry to write
+extern uint16_t traceCount;     // Entries in the buffer
+extern uint16_t traceLost;      // Entries overwritten since the reset
+
+
+// The timer may run from a clock not synchronous to the CPU:
+// read until two reads agree
+static inline uint16_t trace_ticks()
+{
+    uint16_t t;
+    do {
+        t = TRACE_TIMER;
+    } while( t != TRACE_TIMER );
+    return t;
+}
+
+// Mark the end of a phase. Main loop only, not from the interrupts.
+static inline void trace_mark(uint8_t phase, uint8_t arg)
+{
+    trace_entry_t *e = &(traceBuf[traceHead]);
+    e->ticks = trace_ticks();
+    e->phase = phase;
+    e->arg = arg;
+    traceHead = (traceHead + 1) & (TRACE_SIZE - 1);
+    if( traceCount < TRACE_SIZE ) traceCount++;
+    else traceLost++;
+}
+
+// Entry n of the buffer, oldest first
+const trace_entry_t *trace_get(uint16_t n);
+
+void trace_reset();
+
+#endif // _trace_h_
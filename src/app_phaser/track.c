@@ -0,0 +1,93 @@
+// --------------------------------------------
+// Closed-loop beam tracking (perturb and observe).
+// See track.h
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "track.h"
+
+
+// Neighbours: -A, +A, -B, +B
+#define NEIGHBOUR_COUNT 4
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+void track_start(track_t *t, uint16_t countA, uint16_t countB,
+    uint8_t stride, uint8_t hyst, uint16_t *kA, uint16_t *kB)
+{
+    t->countA = countA ? countA : 1;
+    t->countB = countB ? countB : 1;
+    if( *kA >= t->countA ) *kA = 0;
+    if( *kB >= t->countB ) *kB = 0;
+    t->curA = *kA;
+    t->curB = *kB;
+    t->curRssi = 0;
+    t->flCurValid = false;
+    t->flProbe = false;
+    t->stride = stride ? stride : 1;
+    t->hyst = hyst;
+    t->neighbour = 0;
+    t->moves = 0;
+}
+
+// -------------------------------------------------------------------------
+// Next neighbour of the current state, in rotation.
+// Return false if the state has no neighbours (nothing to track).
+// -------------------------------------------------------------------------
+static bool next_probe(track_t *t)
+{
+    int32_t a, b;
+    uint8_t i;
+
+    for(i=0; i<NEIGHBOUR_COUNT; i++){
+        a = t->curA;
+        b = t->curB;
+        switch( t->neighbour ){
+        case 0: a -= t->stride; break;
+        case 1: a += t->stride; break;
+        case 2: b -= t->stride; break;
+        case 3: b += t->stride; break;
+        }
+        if( ++t->neighbour >= NEIGHBOUR_COUNT ) t->neighbour = 0;
+        if( a < 0 || a >= t->countA || b < 0 || b >= t->countB ) continue;
+        t->probeA = a;
+        t->probeB = b;
+        return true;
+    }
+    return false;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+bool track_next(track_t *t, int16_t rssi, bool valid, uint16_t *kA, uint16_t *kB)
+{
+    bool flMoved = false;
+
+    if( t->flProbe ){
+        if( valid && t->flCurValid && rssi > t->curRssi + t->hyst ){
+            t->curA = t->probeA;
+            t->curB = t->probeB;
+            t->curRssi = rssi;
+            t->moves++;
+            flMoved = true;
+        }
+    }
+    else if( valid ){
+        t->curRssi = rssi;
+        t->flCurValid = true;
+    }
+
+    // Alternate: current state, probe, current state, ...
+    if( !t->flProbe && t->flCurValid && next_probe(t) ){
+        t->flProbe = true;
+        *kA = t->probeA;
+        *kB = t->probeB;
+    }
+    else {
+        t->flProbe = false;
+        *kA = t->curA;
+        *kB = t->curB;
+    }
+    return flMoved;
+}
@@ -0,0 +1,41 @@
+// --------------------------------------------
+// Closed-loop beam tracking (perturb and observe).
+//
+// Bursts alternate between the current antenna state and one of its
+// neighbours (probe). The current state moves to the probe when the
+// probe RSSI beats it by more than the hysteresis. The current state is
+// measured again before each probe, so a moving receiver is followed.
+// Each iteration costs one burst and one result round trip.
+// --------------------------------------------
+
+#ifndef _track_h_
+#define _track_h_
+
+#include "stdmansos.h"
+
+typedef struct
+{
+    uint16_t countA;
+    uint16_t countB;
+    uint16_t curA, curB;        // Current (best) state
+    uint16_t probeA, probeB;    // Neighbour being tried
+    int16_t curRssi;
+    bool flCurValid;
+    bool flProbe;               // Last burst was the probe
+    uint8_t stride;             // Probe distance, value positions
+    uint8_t hyst;               // Move threshold, 1/4 dB
+    uint8_t neighbour;          // Next neighbour to probe
+    uint16_t moves;             // Current state changes
+} track_t;
+
+
+// Start tracking at the position kA, kB. Set the first state to measure.
+void track_start(track_t *t, uint16_t countA, uint16_t countB,
+    uint8_t stride, uint8_t hyst, uint16_t *kA, uint16_t *kB);
+
+// Record the RSSI of the last burst (valid=false if not measured)
+// and set the state for the next burst.
+// Return true when the current state has moved.
+bool track_next(track_t *t, int16_t rssi, bool valid, uint16_t *kA, uint16_t *kB);
+
+#endif // _track_h_
@@ -15,6 +15,12 @@
 
 #define DELAY_RATE 10      // mdelay between global loop iterations
 
+// Uncomment to also take the angle messages over the wired serial link
+// from a co-located phaser (see STEPPER_WIRED in app_phaser).
+// The ACK is sent back the way the request came.
+// #define STEPPER_WIRED 1
+#define STEPPER_LINK_SERIAL_ID 1
+
 
 // -------------------------------------------------------------------------
 // Types and global data
@@ -28,6 +34,14 @@ MSG_DEFINE_BUFFER_WITH_ID(radioBuffer, recv_data_p, RADIO_MAX_PACKET);
 static bool fl_AngleProcessing = false;
 static angle_t newAngle = 0;
 
+#ifdef STEPPER_WIRED
+// Wired link receive buffer; the request came over the link
+MSG_DEFINE_BUFFER_WITH_ID(linkBuffer, link_data_p, sizeof(phaser_angle_t));
+static uint8_t linkState = STEPPER_LINK_WAIT_SYNC;
+static uint8_t linkLen, linkPos;
+static bool fl_AngleWired = false;
+#endif
+
 // Phaser angle setting message
 MSG_NEW_WITH_ID(ack_msg, phaser_angle_t, PH_MSG_Angle);
 
@@ -49,6 +63,46 @@ ComStat_t stat = {0,0,0,0};
 // =========================================================================
 // =========================================================================
 
+// -------------------------------------------------------------------------
+// Wired link to a co-located phaser
+// -------------------------------------------------------------------------
+#ifdef STEPPER_WIRED
+void stepper_link_send(const void *msg, uint8_t len)
+{
+    const uint8_t *p = msg;
+    serialSendByte(STEPPER_LINK_SERIAL_ID, STEPPER_LINK_SYNC);
+    serialSendByte(STEPPER_LINK_SERIAL_ID, len);
+    while( len-- ) serialSendByte(STEPPER_LINK_SERIAL_ID, *p++);
+}
+
+void onLinkRecv(uint8_t b)
+{
+    switch( linkState ){
+    case STEPPER_LINK_WAIT_SYNC:
+        if( b == STEPPER_LINK_SYNC ) linkState = STEPPER_LINK_WAIT_LEN;
+        break;
+    case STEPPER_LINK_WAIT_LEN:
+        linkLen = b;
+        linkPos = 0;
+        linkState = (b > 0 && b <= sizeof(linkBuffer)) ? STEPPER_LINK_DATA : STEPPER_LINK_WAIT_SYNC;
+        break;
+    case STEPPER_LINK_DATA:
+        ((uint8_t *)&linkBuffer)[linkPos++] = b;
+        if( linkPos < linkLen ) break;
+        linkState = STEPPER_LINK_WAIT_SYNC;
+
+        if( ! MSG_SIGNATURE_OK(linkBuffer) ) break;
+        MSG_NEW_PAYLOAD_PTR(linkBuffer, phaser_angle_t, angle_data_p);
+        if( linkBuffer.id == PH_MSG_Angle && angle_data_p->action == MSG_ACT_SET ){
+            newAngle = angle_data_p->angle;
+            fl_AngleWired = true;
+            fl_AngleProcessing = true; // set the angle at first convenience
+        }
+        break;
+    }
+}
+#endif
+
 // -------------------------------------------------------------------------
 // -------------------------------------------------------------------------
 bool setAngle(int angle)
@@ -66,6 +120,12 @@ bool setAngle(int angle)
     ack_msg.payload.angle = angle;
     ack_msg.payload.action = MSG_ACT_ACK;
     MSG_DO_CHECKSUM( ack_msg );
+#ifdef STEPPER_WIRED
+    if( fl_AngleWired ){
+        stepper_link_send(&ack_msg, sizeof(ack_msg));
+    }
+    else
+#endif
     MSG_RADIO_SEND( ack_msg );
 
     fl_AngleProcessing = false; // angle request done
@@ -117,6 +177,9 @@ void onRadioRecv(void)
 
         if( angle_data_p->action == MSG_ACT_SET ){
             newAngle = angle_data_p->angle;
+#ifdef STEPPER_WIRED
+            fl_AngleWired = false;
+#endif
             fl_AngleProcessing = true; // set the angle at first convenience
         }
         break;
@@ -133,6 +196,12 @@ void appMain(void)
     radioSetReceiveHandle(onRadioRecv);
     radioOn();
 
+#ifdef STEPPER_WIRED
+    serialInit(STEPPER_LINK_SERIAL_ID, STEPPER_LINK_BAUD, 0);
+    serialSetReceiveHandle(STEPPER_LINK_SERIAL_ID, onLinkRecv);
+    serialEnableRX(STEPPER_LINK_SERIAL_ID);
+#endif
+
     stepperZero();
 
     while (1) {
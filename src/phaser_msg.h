@@ -25,6 +25,22 @@ enum {
     PH_MSG_Config = 'G',
     PH_MSG_Test = 'T',      // Test message, like ping, but with configuration
     PH_MSG_Text = 'X',
+    PH_MSG_Converged = 'V', // Monitor: RSSI mean of the experiment is stable
+    PH_MSG_Result = 'R',    // RSSI summary of an experiment, beam search
+    PH_MSG_Session = 'S',   // Test setup: driver name, comment and config
+    PH_MSG_ConfigAck = 'K', // Phaser: received config swapped in or rejected
+    PH_MSG_Cw = 'W',        // Continuous wave sweep follows
+    PH_MSG_Echo = 'E',      // Monitor: reply to a test message, reverse link
+    PH_MSG_EchoResult = 'Q',// Phaser: reverse link RSSI summary of an experiment
+    PH_MSG_Channel = 'H',   // Phaser: both nodes hop to the radio channel
+    PH_MSG_Beacon = 'B',    // TDMA: monitor frame reference, phaser ready
+    PH_MSG_Shard = 'D',     // Monitor: run a shard of the campaign
+    PH_MSG_ConfigTlv = 'L', // TLV config chunk, replaces the running config
+    PH_MSG_TestCompact = 'M', // Test message, the monitor rebuilds the rest
+    PH_MSG_Anchor = 'N',    // Phaser: sweep position of the compact pings
+    PH_MSG_Trace = 'Y',     // Phaser: timing trace dump, on request
+    PH_MSG_Bench = 'U',     // Benchmark: burst start and end, TX counters
+    PH_MSG_BenchPing = 'O', // Benchmark: fixed length ping of a burst
 };
 
 
@@ -76,6 +92,32 @@ typedef struct
 
 
 
+// Order of the values in a sweep dimension
+enum {
+    SWEEP_ORDER_LINEAR = 0,     // start, start+step, ...
+    SWEEP_ORDER_GRAY = 1,       // one index bit changes per step (count 2^n)
+};
+
+
+// Sweep over the antenna states at each angle
+enum {
+    SWEEP_MODE_FULL = 0,        // All the states
+    SWEEP_MODE_SEARCH = 1,      // Coarse-to-fine search of the best state
+    SWEEP_MODE_TRACK = 2,       // Follow the best state, at the first angle
+    SWEEP_MODE_SETTLE = 3,      // Calibrate the antenna settle time
+    SWEEP_MODE_CW = 4,          // Carrier, one time slot per state, no pings
+};
+
+
+// PhaserTX: phase encoding of the antenna state (test_config_t.ant_encoding)
+enum {
+    PHASERTX_ENC_NIBBLE = 0,    // phase: 4 bits per channel, LSB not used
+    PHASERTX_ENC_CONT = 1,      // phase: 6-bit, ~0 - ~180 deg continuous
+    PHASERTX_ENC_DUAL = 2,      // phase: channel 1, attenuation: channel 2
+                                // phase. 5 bits each, no attenuation
+};
+
+
 // Angle configuration type
 typedef uint16_t angle_t;
 enum { ANGLE_NOT_SET_VALUE= 0xffff };
@@ -92,34 +134,126 @@ typedef struct
     loop_int_t phaseA;
     loop_int_t phaseB;
     loop_int_t angle;
+    loop_int_t channel;
 } test_loop_t;
 
 // Default value (0). Use to init variables of this type.
-#define TEST_LOOP_INIT_VAL { LOOP_INT_0,LOOP_INT_0,LOOP_INT_0,LOOP_INT_0 }
+#define TEST_LOOP_INIT_VAL { LOOP_INT_0,LOOP_INT_0,LOOP_INT_0,LOOP_INT_0,LOOP_INT_0 }
+
+// 802.15.4 radio channels. The stepper and the test setup use the home one.
+#ifdef RADIO_CHANNEL
+#define PH_CHANNEL_HOME     RADIO_CHANNEL
+#else
+#define PH_CHANNEL_HOME     26
+#endif
+#define PH_CHANNEL_MIN      11
+#define PH_CHANNEL_MAX      26
 
 #define TEST_CONFIG_POWER_LIST_SIZE  8
 
+// Sweep dimensions of the schedule at an angle.
+// By default they come from the test_config_t fields: power innermost,
+// then the two antenna dimensions and the channel. test_config_t.dim_order
+// sets another nesting: one kind per 4 bits, innermost first, 0 ends;
+// the kinds not given follow in the default order. A TLV config may give
+// any of them as a range or a value list, and the dwell as one more.
+// It may also sweep single elements of the antenna state vector.
+enum {
+    SWEEP_DIM_POWER = 1,    // TX power, 0..31
+    SWEEP_DIM_ANT_A = 2,    // First antenna dimension, driver value positions
+    SWEEP_DIM_ANT_B = 3,    // Second antenna dimension, driver value positions
+    SWEEP_DIM_CHANNEL = 4,  // Radio channel
+    SWEEP_DIM_DWELL = 5,    // Pings of the step, instead of send_count
+    SWEEP_DIM_KINDS
+};
+#define SWEEP_DIM_ORDER_DEFAULT 0x4321
+// Element i of ant_state_t, the element value itself. It is set over
+// the state the driver gives for the A and B positions. TLV only.
+#define SWEEP_DIM_ELEMENT   16
+#define SWEEP_DIM_IS_ELEMENT(kind) \
+    ((kind) >= SWEEP_DIM_ELEMENT && (kind) < SWEEP_DIM_ELEMENT + ANT_FORMAT_ELEMENTS_MAX)
+#define SWEEP_DIM_MAX       8
+#define SWEEP_LIST_MAX      32
+
+// Values of a dimension
+enum {
+    SWEEP_VAL_RANGE = 0,    // start + k*step
+    SWEEP_VAL_LIST = 1,     // sweep_spec_t.list[start + k]
+    SWEEP_VAL_POWER = 2,    // test_config_t.power[k]
+};
+
+typedef struct
+{
+    uint8_t kind;           // SWEEP_DIM_*
+    uint8_t values;         // SWEEP_VAL_*
+    uint16_t count;
+    uint16_t start;         // Range start, or list offset
+    uint16_t step;
+} __attribute__((packed)) 
+sweep_dim_t;
+
+// Sweep dimensions given by a TLV config. dimCount 0: none, the fields
+// of the test_config_t are used.
+typedef struct
+{
+    uint8_t dimCount;
+    sweep_dim_t dim[SWEEP_DIM_MAX];     // Innermost first
+    uint16_t list[SWEEP_LIST_MAX];
+} sweep_spec_t;
+
 //--------------------------------------------
-// Antenna state variables, union by platform
-// This defines the state and is updated during the each test run
-typedef union 
+// Antenna state variables: the states of the array elements, packed.
+// This defines the state and is updated during the each test run.
+// Element i takes bits i*bits .. i*bits+bits-1 of el[], LSB first; the
+// width is 1, 2, 4 or 8 bits, so an element never crosses a byte. The
+// format tells the element count and width, so the monitor needs no
+// per-board tables. The 2-element boards use the named fields.
+#define ANT_STATE_BYTES     8       // Up to 8 elements of 8 bits, 16 of 4
+typedef struct
 {
-    struct {
-        uint16_t i16;
+    union {
+        uint8_t el[ANT_STATE_BYTES];
+        struct {
+            uint16_t i16;
+        };
+        struct {        // Phaser
+            uint8_t phaseA;
+            uint8_t phaseB;
+        };
+        struct {        // PhaserTX
+            uint8_t phase;
+            uint8_t attenuation;
+        };
+        struct {        // Santa
+            uint8_t santa_pins;
+            uint8_t santa_extra;
+        };
     };
-    struct {        // Phaser
-        uint8_t phaseA;
-        uint8_t phaseB;
-    };
-    struct {        // PhaserTX
-        uint8_t phase;
-        uint8_t attenuation;
-    };
-    struct {        // Santa
-        uint8_t santa_pins;
-        uint8_t santa_extra;
-    };
-} ant_state_t;
+    uint8_t format;     // ANT_FORMAT(elements, bits)
+} __attribute__((packed)) 
+ant_state_t;
+
+#define ANT_FORMAT(elements, bits)  ((((elements) - 1) << 4) | (bits))
+#define ANT_FORMAT_ELEMENTS(f)      (((f) >> 4) + 1)
+#define ANT_FORMAT_BITS(f)          ((f) & 0x0f)
+#define ANT_FORMAT_ELEMENTS_MAX     16
+#define ANT_FORMAT_2x8              ANT_FORMAT(2, 8)
+
+// Element i of the state, bits wide
+#define ANT_EL_MASK(bits)           ((uint8_t)((1 << (bits)) - 1))
+#define ANT_EL_GET(ant, i, bits) \
+    (((ant)->el[((i) * (bits)) >> 3] >> (((i) * (bits)) & 7)) & ANT_EL_MASK(bits))
+#define ANT_EL_SET(ant, i, bits, v) do { \
+    uint8_t *_p = &((ant)->el[((i) * (bits)) >> 3]); \
+    uint8_t _s = ((i) * (bits)) & 7; \
+    *_p = (*_p & ~(ANT_EL_MASK(bits) << _s)) | (((v) & ANT_EL_MASK(bits)) << _s); \
+    } while(0)
+
+#define ANT_STATE_CLEAR(ant, fmt) do { \
+    memset((ant)->el, 0, ANT_STATE_BYTES); \
+    (ant)->format = (fmt); \
+    } while(0)
+#define ANT_STATE_EQ(a, b)          (memcmp((a), (b), sizeof(ant_state_t)) == 0)
 
 // Antena configuration parameters, union by platform
 // These define the test parameters, limits, iteration count, etc.
@@ -149,8 +283,24 @@ typedef struct
     uint16_t send_delay;    // delay between test message sends in ms
     uint16_t angle_step;
     uint16_t angle_count;
+    uint16_t send_count_min;    // Adaptive: min pings before early stop. 0: off
+    uint8_t converge_ci;        // Adaptive: RSSI mean 95% CI half-width, 1/4 dB
     tx_power_t power[TEST_CONFIG_POWER_LIST_SIZE];
     ant_test_config_t ant;
+    uint8_t ant_order;      // SWEEP_ORDER_* for the antenna dimensions
+    uint8_t sweep_mode;     // SWEEP_MODE_*. Search uses power[0] only.
+                            // CW: send_delay - slot ms, send_count - passes
+    uint8_t search_coarse;  // Search: coarse grid points per dimension
+    uint8_t track_step;     // Track: probe distance, value positions
+    uint8_t track_hyst;     // Track: RSSI gain to move, 1/4 dB
+    uint8_t config_idx;     // Index of the config in the phaser testSet[]
+    uint8_t ant_encoding;   // Driver specific antenna state encoding, 0: default
+    uint8_t settle_tol;     // Settle: RSSI offset from the settled state, 1/4 dB
+    uint8_t echo;           // 1: monitor echoes each ping, the phaser measures
+                            // the reverse link. Not in CW mode.
+    iter8_config_t channel; // Radio channel sweep, outermost at each angle.
+                            // count 0: PH_CHANNEL_HOME. Full sweep mode only.
+    uint16_t dim_order;     // Nesting of the sweep dimensions, 0: default
 } test_config_t;
 
 
@@ -165,16 +315,59 @@ typedef struct
     uint16_t expIdx;     // Experiment index/counter
     angle_t angle;
 
-    ant_state_t ant;
-    // phase_t phaseA;
-    // phase_t phaseB;
+    ant_state_t ant;     // Full element state vector
 
     uint8_t power;       // cc2420: 0(min) - 31(max)
+    uint8_t configIdx;   // test_config_t.config_idx of this experiment
+    uint8_t channel;     // Radio channel of the ping
+    uint8_t nodeId;      // Phaser node, see PH_NODE_MAX
 
 } __attribute__((packed)) 
 phaser_ping_t;
 // phaser_config_t;
 
+// Compact test message.
+// The monitor rebuilds the other phaser_ping_t fields from the config and
+// the last anchor of the epoch: the sweep is deterministic, so
+//  d = expIdx - anchor.expIdx + anchor.step
+//  angle = anchor.angle + (d / steps) * angle_step, schedule step d % steps
+// Full sweep mode, with the antenna state linear in the two dimensions
+// (see ant_state_linear), and a config the monitor has; otherwise the
+// phaser sends phaser_ping_t.
+// PH_PING_PAD bytes of padding make a controlled frame length.
+#ifndef PH_PING_PAD
+#define PH_PING_PAD     0
+#endif
+typedef struct
+{
+    uint8_t epoch;       // Anchor of the ping, node in the high bits as
+                         // the control seq, see PH_CTRL_SEQ_NODE()
+    uint16_t expIdx;
+    uint8_t seq;         // msgCounter, low byte
+#if PH_PING_PAD > 0
+    uint8_t pad[PH_PING_PAD];
+#endif
+} __attribute__((packed)) 
+phaser_ping_compact_t;
+
+// Sweep position of the compact pings from now on, sequenced as
+// phaser_control_t. Sent at each change of the config or of the
+// expIdx sequence; the monitor does not ACK a config it does not have.
+typedef struct
+{
+    msg_action_t action; // SET
+    uint8_t seq;
+    uint8_t epoch;
+    uint8_t configIdx;
+    uint16_t expIdx;
+    angle_t angle;       // Of expIdx
+    uint16_t step;       // Schedule step of expIdx
+    uint8_t nodeId;
+} __attribute__((packed)) 
+phaser_anchor_t;
+
+#define PH_EPOCH_MASK   ((1 << PH_CTRL_SEQ_NODE_SHIFT) - 1)
+
 typedef struct
 {
     angle_t angle;
@@ -182,12 +375,379 @@ typedef struct
 } __attribute__((packed)) 
 phaser_angle_t;
 
+// Reliable control.
+// The receiver replies to a sequenced message (seq != 0) with a control 
+// ACK of the same seq. A duplicate seq, within PH_CTRL_DUP_WINDOW_MS, is 
+// ACKed again but not processed.
 typedef struct
 {
     msg_action_t action;
+    uint8_t seq;         // Sequence number, 0: not sequenced, no ACK
 } __attribute__((packed)) 
 phaser_control_t;
 
+#define PH_CTRL_DUP_WINDOW_MS  3000
+
+// Reply to a config sent to the phaser during the test.
+// The config replaces the running one from the next experiment, until the
+// end of the testSet[] entry it replaces, or of a merged campaign; the
+// sweep at the current angle restarts with it. The stepper and the
+// counters are kept. The phaser sends the config it runs, PH_MSG_Config,
+// before the ACK.
+// A config is rejected while another one waits for the swap; in a merged
+// campaign also if it changes the angles, or another entry was swapped.
+typedef struct
+{
+    uint8_t epoch;          // Number of the configs swapped in since boot
+    uint8_t configIdx;      // testSet[] entry replaced
+    uint16_t expIdx;        // First experiment with the new config
+    msg_action_t action;    // ACK: swapped in, STOP: rejected,
+                            // PH_ACT_INCOMPLETE: TLV chunks lost
+} __attribute__((packed)) 
+phaser_config_ack_t;
+
+// Continuous wave sweep, sequenced as phaser_control_t.
+// After the ACK the phaser turns on the unmodulated carrier, at the max
+// power and the first state, for CW_PREAMBLE_MS. Then each schedule step
+// at the angle gets a slot of slotMs, all of them repeat times. The
+// monitor finds the carrier onset from the RSSI and bins the RSSI 
+// samples by slot, skipping CW_GUARD_MS at both slot edges.
+// Slot n of the sweep is experiment expIdx + n.
+typedef struct
+{
+    msg_action_t action;    // START: the sweep follows, STOP: aborted
+    uint8_t seq;
+    uint16_t expIdx;        // Experiment of the first slot
+    angle_t angle;
+    uint8_t configIdx;
+    uint16_t slotCount;     // Slots of one pass
+    uint8_t slotMs;         // Slot duration (test_config_t.send_delay)
+    uint8_t repeat;         // Passes (test_config_t.send_count)
+} __attribute__((packed)) 
+phaser_cw_t;
+
+#define CW_LEAD_MS          50      // ACK to carrier on
+#define CW_PREAMBLE_MS      5       // Carrier onset to the first slot
+#define CW_GUARD_MS         1       // Not sampled, slot start and end
+#define CW_SLOT_MS_MIN      (2*CW_GUARD_MS + 1)
+#define CW_SLOT_MAX         256
+
+// Phaser control actions, above the msg_action_t values of msg_framework
+#define PH_ACT_BASE    0x40
+// Monitor to phaser control: continue the campaign from the checkpoint
+#define PH_ACT_RESUME  (PH_ACT_BASE + 0)
+// Phaser config ACK: TLV chunks missing, the transfer was dropped
+#define PH_ACT_INCOMPLETE  (PH_ACT_BASE + 1)
+
+// Name of an action, MSG_ACT_NAME() knows only the framework ones
+#define PH_ACT_NAME(a) ((a) == PH_ACT_RESUME ? "RESUME" : \
+    (a) == PH_ACT_INCOMPLETE ? "INCOMPLETE" : MSG_ACT_NAME(a))
+
+// Test session setup, sequenced as phaser_control_t.
+// A merged campaign sends one per config; all but the last one are SET.
+#define PH_SESSION_NAME_LEN  24
+typedef struct
+{
+    msg_action_t action;    // START: start the test, SET: config only
+    uint8_t seq;
+    uint8_t configCount;    // Configs of the session
+    char name[PH_SESSION_NAME_LEN];     // Driver name and comment
+    test_config_t config;
+} __attribute__((packed)) 
+phaser_session_t;
+
+typedef struct
+{
+    uint16_t expIdx;     // Experiment that has converged
+    uint8_t nodeId;
+} __attribute__((packed)) 
+phaser_converged_t;
+
+typedef struct
+{
+    uint16_t expIdx;
+    int16_t rssi;        // RSSI mean, 1/4 dB
+    uint16_t num;        // Pings received; DONE: states measured or moves;
+                         // SET: settle time, us
+    angle_t angle;       // DONE, SET only
+    ant_state_t ant;     // DONE only: best antenna state
+    msg_action_t action; // STATUS: request, ACK: reply, DONE: search result,
+                         // SET: settle calibration result
+    uint8_t nodeId;      // STATUS, ACK: the phaser node
+} __attribute__((packed)) 
+phaser_result_t;
+
+
+// Reverse link measurement.
+// The monitor replies to each test message of an echo config with a short
+// echo. The phaser receives it with the antenna state of the ping and 
+// after each experiment sends the RSSI/LQI of the echoes received.
+typedef struct
+{
+    uint16_t expIdx;
+    uint16_t msgCounter;    // Of the ping echoed
+    uint8_t nodeId;
+} __attribute__((packed)) 
+phaser_echo_t;
+
+#define ECHO_WAIT_MS        5       // Last ping to the last echo
+
+// Channel hop, sequenced as phaser_control_t.
+// Sent on the current channel; the monitor ACKs and hops, the phaser hops
+// after the ACK or the last retry. The phaser returns to PH_CHANNEL_HOME
+// for each stepper move. The monitor returns to it when nothing is 
+// received for PH_CHANNEL_IDLE_MS (more than the longest send_delay).
+typedef struct
+{
+    msg_action_t action;    // SET
+    uint8_t seq;
+    uint8_t channel;
+    uint16_t expIdx;        // First experiment on the channel
+} __attribute__((packed)) 
+phaser_channel_t;
+
+#define PH_CHANNEL_IDLE_MS  15000
+
+typedef struct
+{
+    uint16_t expIdx;
+    uint8_t configIdx;
+    angle_t angle;
+    ant_state_t ant;
+    uint8_t power;
+    uint16_t sent;          // Pings sent
+    uint16_t num;           // Echoes received
+    int16_t rssi;           // RSSI mean, 1/4 dB
+    uint8_t lqi;            // LQI mean
+    uint32_t rssiDevSq;     // As the monitor Test: output
+    uint8_t nodeId;
+} __attribute__((packed)) 
+phaser_echo_result_t;
+
+
+// TLV config: records of type, length and value (little endian), applied
+// on top of the running config, like PH_MSG_Config; unknown types are
+// skipped. TLV_DIM_* records give the sweep dimensions, innermost first;
+// with any of them, the dimensions not given are not swept. Full and CW
+// sweep modes only. A config longer than one chunk is sent in several;
+// the phaser replies with a PH_MSG_ConfigAck when it has all of them, or
+// PH_ACT_INCOMPLETE when some are missing after a timeout.
+enum {
+    TLV_START_DELAY = 1,    // u16
+    TLV_SEND_DELAY = 2,     // u16
+    TLV_SEND_COUNT = 3,     // u16
+    TLV_ANGLE = 4,          // u16 step, u16 count
+    TLV_ANT_A = 5,          // u8 start, u8 step, u16 count
+    TLV_ANT_B = 6,          // u8 start, u8 step, u16 count
+    TLV_ANT_ORDER = 7,      // u8
+    TLV_ANT_ENCODING = 8,   // u8
+    TLV_SWEEP_MODE = 9,     // u8
+    TLV_ADAPTIVE = 10,      // u16 send_count_min, u8 converge_ci
+    TLV_ECHO = 11,          // u8
+    TLV_DIM_RANGE = 32,     // u8 kind, u16 start, u16 step, u16 count
+    TLV_DIM_LIST = 33,      // u8 kind, u16 values...
+};
+
+// Value bytes, for writing the TLV configs
+#define TLV_U16(v)          (uint8_t)((v) & 0xff), (uint8_t)((v) >> 8)
+
+#define PH_TLV_CHUNK        96
+#define PH_TLV_CHUNK_COUNT  4
+#define PH_TLV_MAX          (PH_TLV_CHUNK_COUNT * PH_TLV_CHUNK)
+typedef struct
+{
+    uint8_t xfer;           // Transfer ID, new for each config
+    uint8_t idx;            // Chunk
+    uint8_t count;          // Chunks of the config
+    uint8_t len;            // Bytes of data, PH_TLV_CHUNK but the last one
+    uint8_t data[PH_TLV_CHUNK];
+} __attribute__((packed)) 
+phaser_tlv_chunk_t;
+
+// Timing trace of the phaser test loop, see app_phaser/trace.h.
+// Each entry marks the end of a phase with the timer counter; the phase
+// took the ticks since the previous entry. src/tools/trace_hist.py reads
+// the names below from this file.
+enum {
+    TRACE_DUMP = 1,         // Trace dump, the trace restarts after it
+    TRACE_STEP = 2,         // test_step() start: the main loop since the last step
+    TRACE_DRAIN = 3,        // tx_drain(): the last ping of the previous step
+    TRACE_ANT_LATCH = 4,    // ant_test_stage(), ant_test_latch()
+    TRACE_ANGLE = 5,        // set_angle(), channel_set()
+    TRACE_POWER = 6,        // radio_set_power()
+    TRACE_SETTLE = 7,       // ant_test_settle()
+    TRACE_SLOT = 8,         // Ping: TX slot or TDMA slot wait
+    TRACE_TX_WAIT = 9,      // Ping: cc2420IsTxBusy() before the frame load
+    TRACE_CHECKSUM = 10,    // Ping: MSG_DO_CHECKSUM()
+    TRACE_SEND = 11,        // Ping: MSG_RADIO_SEND(), frame load and TX start
+    TRACE_TX_BUSY = 12,     // Ping: cc2420IsTxBusy() after the send
+    TRACE_DELAY = 13,       // Ping: mdelay_var() pacing
+    TRACE_ECHO = 14,        // echo_report()
+    TRACE_NEXT = 15,        // test_next(): the next state staged
+};
+
+typedef struct
+{
+    uint16_t ticks;         // Timer counter at the end of the phase
+    uint8_t phase;          // TRACE_*
+    uint8_t arg;            // Ping phases: the ping of the step, low byte
+} __attribute__((packed)) 
+trace_entry_t;
+
+// Trace dump. The monitor sends STATUS, the phaser replies with the
+// entries, oldest first, in SET messages, and DONE with the totals.
+// Not acknowledged: a lost chunk leaves a gap in idx.
+#define PH_TRACE_CHUNK  20
+typedef struct
+{
+    msg_action_t action;    // STATUS: request, SET: entries, DONE: end
+    uint8_t nodeId;
+    uint16_t idx;           // SET: first entry, DONE: entries sent
+    uint8_t count;          // SET: entries in e[]
+    uint16_t lost;          // DONE: entries overwritten before the dump
+    uint32_t tickHz;        // DONE: timer counter rate
+    trace_entry_t e[PH_TRACE_CHUNK];
+} __attribute__((packed)) 
+phaser_trace_t;
+
+// Sharded campaign: the rig runs only its part of the sequential campaign
+// sweep, see app_phaser/shard.h. The phaser replies with the same message,
+// ACK or STOP (rejected), and restarts the campaign with the shard.
+// shardCount 0 or 1: the whole campaign.
+enum {
+    SHARD_MODE_RANGE = 0,       // Contiguous part, fewest stepper moves
+    SHARD_MODE_STRIDE = 1,      // Every shardCount-th experiment
+};
+
+typedef struct
+{
+    msg_action_t action;    // SET: request, ACK or STOP: reply
+    uint8_t shardIdx;
+    uint8_t shardCount;
+    uint8_t mode;           // SHARD_MODE_*
+    uint32_t first;         // Reply: global index of the first experiment
+    uint32_t end;           // Reply: past the last one
+} __attribute__((packed)) 
+phaser_shard_t;
+
+
+//===========================================
+// Several phaser nodes
+//===========================================
+// Each phaser node has an ID, 0 .. PH_NODE_MAX-1, in its pings. The monitor
+// keeps the experiment state by node.
+// The sequence numbers of the control messages carry the node ID in the
+// top bits, so the ACKs and the duplicate checks do not mix the nodes.
+#define PH_NODE_MAX             8
+#define PH_NODE_ALL             0xff
+#define PH_CTRL_SEQ_NODE_SHIFT  5
+#define PH_CTRL_SEQ_NODE(seq)   ((seq) >> PH_CTRL_SEQ_NODE_SHIFT)
+
+// TDMA: the phaser nodes share the channel in time slots. 
+// The monitor sends a beacon at the start of a frame every 
+// PH_TDMA_BEACON_MS; slot 0 of each frame is kept for it, node n pings 
+// in slot n+1. The phasers keep the grid from the last beacon.
+// Node 0 drives the stepper. It moves on when all the active nodes are 
+// ready for the next angle, or after PH_TDMA_WAIT_MS. The other nodes 
+// send a beacon with their ID and the angle they wait for, until the 
+// monitor reports them ready.
+#define PH_TDMA_NODES           4
+#define PH_TDMA_SLOT_MS         5
+#define PH_TDMA_FRAME_MS        ((PH_TDMA_NODES + 1) * PH_TDMA_SLOT_MS)
+#define PH_TDMA_BEACON_MS       (40 * PH_TDMA_FRAME_MS)
+#define PH_TDMA_ACTIVE_MS       30000   // Node not heard: not waited for
+#define PH_TDMA_WAIT_MS         60000   // Longest wait for the angle
+
+typedef struct
+{
+    uint16_t frame;         // Monitor: beacon counter
+    angle_t angle;          // Monitor: stepper angle. Node: angle waited for
+    uint8_t nodeId;         // PH_NODE_ALL: from the monitor
+    uint8_t activeMask;     // Nodes heard during PH_TDMA_ACTIVE_MS
+    uint8_t readyMask;      // Nodes ready for the next angle
+} __attribute__((packed)) 
+phaser_beacon_t;
+
+
+//===========================================
+// Radio throughput benchmark
+//===========================================
+// app_bench_tx sends bursts of PH_MSG_BenchPing to app_bench_rx, for each
+// ping size and gap of its plan. PH_MSG_Bench START goes before a burst,
+// DONE with the TX counters after it, each PH_BENCH_CTRL_REPEAT times;
+// the receiver drops the repeats by the burst number.
+// The message framework has one size per payload type, so each ping size
+// is a type of its own, PH_BENCH_PING_DECLARE() below.
+#define PH_BENCH_CTRL_REPEAT    3
+
+enum {
+    PH_BENCH_SIZE_8 = 0,
+    PH_BENCH_SIZE_32 = 1,
+    PH_BENCH_SIZE_64 = 2,
+    PH_BENCH_SIZE_100 = 3,
+    PH_BENCH_SIZES
+};
+
+// Ping payload bytes from PH_BENCH_SIZE_*
+#define PH_BENCH_SIZE_BYTES( sizeIdx )  ( \
+    (sizeIdx)==PH_BENCH_SIZE_8 ? 8 :  \
+    (sizeIdx)==PH_BENCH_SIZE_32 ? 32 :  \
+    (sizeIdx)==PH_BENCH_SIZE_64 ? 64 :  \
+    (sizeIdx)==PH_BENCH_SIZE_100 ? 100 :  \
+    0 )
+
+typedef struct
+{
+    uint16_t burst;         // Burst number, from 1
+    uint16_t seq;           // Ping of the burst, from 0
+    uint8_t sizeIdx;        // PH_BENCH_SIZE_*
+    uint8_t gapMs;          // Delay between the pings
+} __attribute__((packed)) 
+phaser_bench_hdr_t;
+
+#define PH_BENCH_PING_DECLARE( bytes )  \
+    typedef struct {  \
+        phaser_bench_hdr_t h;  \
+        uint8_t pad[(bytes) - sizeof(phaser_bench_hdr_t)];  \
+    } __attribute__((packed)) phaser_bench_ping##bytes##_t
+
+PH_BENCH_PING_DECLARE(8);
+PH_BENCH_PING_DECLARE(32);
+PH_BENCH_PING_DECLARE(64);
+PH_BENCH_PING_DECLARE(100);
+
+typedef struct
+{
+    msg_action_t action;    // START: burst follows, DONE: burst sent
+    uint16_t burst;
+    uint8_t sizeIdx;        // PH_BENCH_SIZE_*
+    uint8_t gapMs;
+    uint16_t count;         // Pings in the burst
+    // DONE: TX side of the burst
+    uint16_t txFail;        // Radio send returned an error
+    uint16_t txMs;          // First ping to the end of the last one
+    uint32_t txBusyTicks;   // In the radio send and the TX busy wait
+    uint32_t tickHz;        // Rate of the tick counters
+} __attribute__((packed)) 
+phaser_bench_t;
+
+
+//===========================================
+// Wired stepper link
+//===========================================
+// A phaser co-located with the stepper may send the angle messages over
+// a UART instead of the radio. Same messages and ACK semantics; each one
+// is framed as: STEPPER_LINK_SYNC, length, message bytes.
+#define STEPPER_LINK_SYNC   0x7e
+#define STEPPER_LINK_BAUD   38400
+
+// Frame receiver states
+enum {
+    STEPPER_LINK_WAIT_SYNC,
+    STEPPER_LINK_WAIT_LEN,
+    STEPPER_LINK_DATA,
+};
+
 
 //===========================================
 // Experimental data
@@ -199,9 +759,11 @@ STREAM_STAT_DECLARE(lqi_data_t, int32_t);
 typedef struct 
 {
     // int expIdx;
+    uint8_t configIdx;
     tx_power_t power;
     angle_t angle;
-    phase_t phase;
+    ant_state_t ant;
+    uint8_t channel;
     rssi_data_t rssi_data;
     lqi_data_t lqi_data;
 } experiment_t;
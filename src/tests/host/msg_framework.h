@@ -0,0 +1,20 @@
+// --------------------------------------------
+// Host build: the message framework types used by phaser_msg.h
+// --------------------------------------------
+
+#ifndef _host_msg_framework_h_
+#define _host_msg_framework_h_
+
+#include "stdmansos.h"
+
+typedef uint32_t msg_timestamp_t;
+typedef uint8_t msg_action_t;
+enum {
+    MSG_ACT_CLEAR, MSG_ACT_START, MSG_ACT_STOP, MSG_ACT_IDLE, MSG_ACT_DONE,
+    MSG_ACT_RESTART, MSG_ACT_STATUS, MSG_ACT_ACK, MSG_ACT_SET
+};
+
+#define MSG_TEXT_SIZE_MAX 32
+typedef struct { char text[MSG_TEXT_SIZE_MAX]; } msg_text_data_t;
+
+#endif // _host_msg_framework_h_
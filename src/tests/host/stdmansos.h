@@ -0,0 +1,21 @@
+// --------------------------------------------
+// Host build of the platform independent modules, for the tests.
+// Just enough of the MansOS API for them to compile.
+// --------------------------------------------
+
+#ifndef _host_stdmansos_h_
+#define _host_stdmansos_h_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+#define PRINTF(...) printf(__VA_ARGS__)
+
+typedef int Handle_t;
+#define ATOMIC_START(h) ((h) = 0)
+#define ATOMIC_END(h)   ((void)(h))
+
+#endif // _host_stdmansos_h_
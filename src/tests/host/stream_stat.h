@@ -0,0 +1,11 @@
+// --------------------------------------------
+// Host build: running statistics, as in MansOS
+// --------------------------------------------
+
+#ifndef _host_stream_stat_h_
+#define _host_stream_stat_h_
+
+#define STREAM_STAT_DECLARE(name, type) \
+    typedef struct { int num; type sum; type sum_squares; } name
+
+#endif // _host_stream_stat_h_
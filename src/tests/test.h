@@ -0,0 +1,27 @@
+// --------------------------------------------
+// Host tests: the check macro and the result
+// --------------------------------------------
+
+#ifndef _test_h_
+#define _test_h_
+
+#include <stdio.h>
+
+static int testFailed = 0;
+static int testCount = 0;
+
+#define CHECK(cond, ...) do{ \
+    testCount++; \
+    if( !(cond) ){ \
+        testFailed++; \
+        printf("%s:%d: %s: ", __FILE__, __LINE__, #cond); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+}while(0)
+
+#define TEST_RESULT(name) ( \
+    printf("%s: %d checks, %d failed\n", name, testCount, testFailed), \
+    testFailed ? 1 : 0 )
+
+#endif // _test_h_
@@ -0,0 +1,100 @@
+// --------------------------------------------
+// PE46120 serial words: the bit order of the transfer and the skip of
+// the unchanged channel words. Built for both transfers, see Makefile.
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "pe46120.h"
+
+#include "test.h"
+
+
+// Frames sent by pe46120_write()
+static uint16_t sent[8];
+static int sentCount;
+
+void pe46120_send_word(uint16_t frame)
+{
+    if( sentCount < 8 ) sent[sentCount] = frame;
+    sentCount++;
+}
+
+// -------------------------------------------------------------------------
+// The word the chip latches: it shifts in the SDI bits LSB first and keeps
+// the last 14 at the LE rising edge.
+// -------------------------------------------------------------------------
+static uint16_t chip_latch(uint16_t frame)
+{
+    uint8_t bits[16];
+    int n = 0, i;
+    uint16_t w = 0;
+
+#ifdef PE46120_USE_SPI
+    // USART: 16 bits, MSB first
+    for(i=15; i>=0; i--) bits[n++] = (frame >> i) & 0x01;
+#else
+    // Bit-bang: 14 bits, LSB first
+    for(i=0; i<14; i++) bits[n++] = (frame >> i) & 0x01;
+#endif
+    for(i=0; i<14; i++) w |= bits[n - 14 + i] << i;
+    return w;
+}
+
+int main()
+{
+    uint8_t p, a, c;
+    uint16_t w;
+    int errors = 0;
+
+    // Bit reversal
+    CHECK(PE46120_REV14(0x0001) == 0x2000, "%x", PE46120_REV14(0x0001));
+    CHECK(PE46120_REV14(0x2000) == 0x0001, "%x", PE46120_REV14(0x2000));
+    CHECK(PE46120_REV14(0x0003) == 0x3000, "%x", PE46120_REV14(0x0003));
+    CHECK(PE46120_REV14(PE46120_REV14(0x1a5c)) == 0x1a5c, "round trip");
+
+    // Every word reaches the chip as the bit-bang one
+    for(c=0; c<2; c++){
+        for(a=0; a<16; a++){
+            for(p=0; p<32; p++){
+                w = chip_latch(pe46120_word(p, a, c));
+                if( w != PE46120_WORD(p, a, c) ) errors++;
+            }
+        }
+    }
+    CHECK(errors == 0, "%d words latched wrong", errors);
+
+    // Word fields
+    w = chip_latch(pe46120_word(0x15, 0x09, 1));
+    CHECK(((w >> 2) & 0x1f) == 0x15, "phase %x", (w >> 2) & 0x1f);
+    CHECK(((w >> 7) & 0x0f) == 0x09, "attenuation %x", (w >> 7) & 0x0f);
+    CHECK((w >> 13) == 1, "channel %x", w >> 13);
+
+    // The first write of each channel is sent
+    sentCount = 0;
+    CHECK(pe46120_write(0, pe46120_word(3, 0, 0)), "channel 0 first write");
+    CHECK(pe46120_write(1, pe46120_word(3, 2, 1)), "channel 1 first write");
+    CHECK(sentCount == 2, "%d sent", sentCount);
+
+    // Unchanged: nothing sent, per channel
+    sentCount = 0;
+    CHECK(!pe46120_write(0, pe46120_word(3, 0, 0)), "channel 0 unchanged");
+    CHECK(!pe46120_write(1, pe46120_word(3, 2, 1)), "channel 1 unchanged");
+    CHECK(sentCount == 0, "%d sent", sentCount);
+
+    // One channel changed: only that one
+    CHECK(pe46120_write(1, pe46120_word(4, 2, 1)), "channel 1 changed");
+    CHECK(!pe46120_write(0, pe46120_word(3, 0, 0)), "channel 0 unchanged");
+    CHECK(sentCount == 1 && chip_latch(sent[0]) == PE46120_WORD(4, 2, 1), "%d sent", sentCount);
+
+    // The same word value on the other channel is still sent
+    sentCount = 0;
+    CHECK(pe46120_write(0, pe46120_word(4, 2, 1)), "channel 0, word of channel 1");
+    CHECK(sentCount == 1, "%d sent", sentCount);
+
+#ifdef PE46120_USE_SPI
+    return TEST_RESULT("pe46120 spi");
+#else
+    return TEST_RESULT("pe46120 bit-bang");
+#endif
+}
@@ -0,0 +1,119 @@
+// --------------------------------------------
+// Compact pings: the monitor rebuild against the sequence the phaser
+// sends, from anchors at and within an angle, across the expIdx wrap.
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "schedule.h"
+#include "ping_rebuild.h"
+
+#include "test.h"
+
+
+#define ANGLES  4
+
+static test_config_t cfg;
+
+// -------------------------------------------------------------------------
+// The phaser: anchor at (expIdx, angle number, step), then the pings of
+// the following experiments. Each step is one experiment; the angle
+// advances at the end of the schedule.
+// -------------------------------------------------------------------------
+static void check_sequence(uint16_t expIdx, uint16_t angleNum, uint16_t step, uint8_t epoch)
+{
+    ping_anchor_t an;
+    phaser_anchor_t a;
+    phaser_ping_compact_t c;
+    phaser_ping_t *p, want;
+    schedule_t sched;
+    test_loop_t idx;
+    int bad = 0, n = 0;
+
+    schedule_init(&sched, &cfg, NULL);
+
+    memset(&a, 0, sizeof(a));
+    a.action = MSG_ACT_SET;
+    a.epoch = epoch;
+    a.configIdx = 3;
+    a.expIdx = expIdx;
+    a.angle = angleNum * cfg.angle_step;
+    a.step = step;
+    a.nodeId = PH_CTRL_SEQ_NODE(epoch);
+    memset(&an, 0, sizeof(an));
+    CHECK(ping_anchor_set(&an, &a, &cfg), "anchor");
+
+    memset(&c, 0, sizeof(c));
+    c.epoch = epoch;
+    c.expIdx = expIdx;
+    for(; angleNum<ANGLES; angleNum++, step=0){
+        for(; step<sched.count; step++, c.expIdx++, n++){
+            memset(&want, 0, sizeof(want));
+            schedule_step(&sched, step, &idx, &want);
+
+            c.seq = n;
+            p = ping_rebuild(&an, &c);
+            if( !p ){
+                bad++;
+                continue;
+            }
+            if( p->expIdx != c.expIdx || p->angle != angleNum * cfg.angle_step ) bad++;
+            if( p->configIdx != 3 || p->nodeId != a.nodeId || p->msgCounter != c.seq ) bad++;
+            if( p->power != want.power || p->channel != want.channel ) bad++;
+            if( !ANT_STATE_EQ(&p->ant, &want.ant) ) bad++;
+
+            // The other pings of the experiment only update msgCounter
+            c.seq = n + 100;
+            p = ping_rebuild(&an, &c);
+            if( !p || p->msgCounter != c.seq || p->power != want.power ) bad++;
+        }
+    }
+    CHECK(bad == 0, "anchor exp %u step %u: %d of %d pings wrong",
+        (unsigned) expIdx, (unsigned) a.step, bad, n);
+    CHECK(an.lost == 0, "lost %u", (unsigned) an.lost);
+
+    // Another epoch: an anchor the monitor missed
+    c.epoch = epoch + 1;
+    CHECK(ping_rebuild(&an, &c) == NULL && an.lost == 1, "other epoch rebuilt");
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+int main()
+{
+    ping_anchor_t an;
+    phaser_anchor_t a;
+    phaser_ping_compact_t c;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.power[0] = 31;
+    cfg.power[1] = 7;
+    cfg.ant.phaseA.start = 4;
+    cfg.ant.phaseA.step = 8;
+    cfg.ant.phaseA.count = 4;
+    cfg.ant.phaseB.step = 2;
+    cfg.ant.phaseB.count = 3;
+    cfg.ant_order = SWEEP_ORDER_GRAY;
+    cfg.angle_step = 15;
+    cfg.angle_count = ANGLES;
+    cfg.send_count = 5;
+
+    check_sequence(0, 0, 0, 1);                 // Campaign start
+    check_sequence(100, 1, 0, 2);               // Angle start
+    check_sequence(205, 1, 7, 3);               // Swap or resume within the angle
+    check_sequence(0xfff0, 2, 5, 0x45);         // expIdx wraps, node 2
+
+    // No anchor yet
+    memset(&an, 0, sizeof(an));
+    memset(&c, 0, sizeof(c));
+    CHECK(ping_rebuild(&an, &c) == NULL && an.lost == 1, "rebuilt without anchor");
+
+    // A config without steps is not anchored
+    memset(&a, 0, sizeof(a));
+    cfg.channel.count = 0;
+    cfg.ant.phaseA.count = 0;
+    cfg.ant.phaseB.count = 0;
+    CHECK(ping_anchor_set(&an, &a, &cfg) && an.sched.count == 2, "power only sweep");
+
+    return TEST_RESULT("ping rebuild");
+}
@@ -0,0 +1,245 @@
+// --------------------------------------------
+// Sweep schedule: the step decode against the nested loops of the old
+// sweep (power innermost, then A, B and the channel), the dimension
+// order and the TLV dimensions, and the element dimensions. TLV chunk
+// reassembly and its timeout.
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "schedule.h"
+#include "tlv.h"
+
+#include "test.h"
+
+
+static void config_make(test_config_t *cfg)
+{
+    memset(cfg, 0, sizeof(test_config_t));
+    cfg->power[0] = 31;
+    cfg->power[1] = 15;
+    cfg->power[2] = 3;
+    cfg->ant.phaseA.start = 2;
+    cfg->ant.phaseA.step = 3;
+    cfg->ant.phaseA.count = 4;
+    cfg->ant.phaseB.start = 1;
+    cfg->ant.phaseB.step = 16;
+    cfg->ant.phaseB.count = 5;
+    cfg->channel.start = 15;
+    cfg->channel.step = 5;
+    cfg->channel.count = 3;
+    cfg->send_count = 7;
+}
+
+// -------------------------------------------------------------------------
+// Steps in the order of the old nested loops
+// -------------------------------------------------------------------------
+static void check_old_order(const test_config_t *cfg)
+{
+    schedule_t s;
+    test_loop_t idx;
+    phaser_ping_t ping;
+    uint16_t p, a, b, c, kA, kB;
+    uint32_t n = 0;
+    int bad = 0;
+
+    schedule_init(&s, cfg, NULL);
+    CHECK(s.count == 3 * 4 * 5 * 3, "count %lu", (unsigned long)s.count);
+
+    for(c=0; c<cfg->channel.count; c++){
+        for(b=0; b<cfg->ant.phaseB.count; b++){
+            for(a=0; a<cfg->ant.phaseA.count; a++){
+                for(p=0; p<3; p++, n++){
+                    schedule_step(&s, n, &idx, &ping);
+                    kA = schedule_order(a, cfg->ant.phaseA.count, cfg->ant_order);
+                    kB = schedule_order(b, cfg->ant.phaseB.count, cfg->ant_order);
+                    if( ping.power != cfg->power[p] ) bad++;
+                    if( ping.ant.phaseA != cfg->ant.phaseA.start + kA * cfg->ant.phaseA.step ) bad++;
+                    if( ping.ant.phaseB != cfg->ant.phaseB.start + kB * cfg->ant.phaseB.step ) bad++;
+                    if( ping.channel != cfg->channel.start + c * cfg->channel.step ) bad++;
+                    if( idx.power.idx != p || idx.phaseA.idx != a
+                            || idx.phaseB.idx != b || idx.channel.idx != c ) bad++;
+                    if( schedule_dwell(&s, n) != cfg->send_count ) bad++;
+                }
+            }
+        }
+    }
+    CHECK(n == s.count, "%lu steps of %lu", (unsigned long)n, (unsigned long)s.count);
+    CHECK(bad == 0, "order %d: %d wrong values", cfg->ant_order, bad);
+}
+
+// -------------------------------------------------------------------------
+// Channel innermost, then power; A and B follow in the default order
+// -------------------------------------------------------------------------
+static void check_dim_order(test_config_t *cfg)
+{
+    schedule_t s;
+    test_loop_t idx;
+    phaser_ping_t ping;
+    uint32_t n;
+    int bad = 0;
+
+    cfg->dim_order = 0x14;
+    schedule_init(&s, cfg, NULL);
+    CHECK(s.dimCount == 4 && s.dim[0].kind == SWEEP_DIM_CHANNEL && s.dim[1].kind == SWEEP_DIM_POWER
+        && s.dim[2].kind == SWEEP_DIM_ANT_A && s.dim[3].kind == SWEEP_DIM_ANT_B, "dimension order");
+
+    for(n=0; n<s.count; n++){
+        schedule_step(&s, n, &idx, &ping);
+        if( idx.channel.idx != n % 3 ) bad++;
+        if( idx.power.idx != n / 3 % 3 ) bad++;
+        if( idx.phaseA.idx != n / 9 % 4 ) bad++;
+        if( idx.phaseB.idx != n / 36 ) bad++;
+    }
+    CHECK(bad == 0, "dim_order: %d wrong indexes", bad);
+    cfg->dim_order = 0;
+}
+
+// -------------------------------------------------------------------------
+// TLV dimensions: an A list inside a dwell range, the rest not swept
+// -------------------------------------------------------------------------
+static void check_tlv_dims(const test_config_t *base)
+{
+    const uint8_t rec[] = {
+        TLV_SEND_DELAY, 2, TLV_U16(25),
+        TLV_DIM_LIST, 7, SWEEP_DIM_ANT_A, TLV_U16(3), TLV_U16(0), TLV_U16(1),
+        TLV_DIM_RANGE, 7, SWEEP_DIM_DWELL, TLV_U16(10), TLV_U16(5), TLV_U16(2),
+        99, 1, 0,       // Unknown, skipped
+    };
+    const uint16_t listA[] = { 3, 0, 1 };
+    test_config_t cfg;
+    sweep_spec_t spec;
+    schedule_t s;
+    test_loop_t idx;
+    phaser_ping_t ping;
+    uint32_t n;
+    int bad = 0;
+
+    memcpy(&cfg, base, sizeof(cfg));
+    CHECK(tlv_parse(rec, sizeof(rec), &cfg, &spec), "parse");
+    CHECK(cfg.send_delay == 25, "send_delay %d", cfg.send_delay);
+    CHECK(schedule_check(&cfg, &spec), "spec check");
+
+    schedule_init(&s, &cfg, &spec);
+    CHECK(s.count == 6, "count %lu", (unsigned long)s.count);
+    for(n=0; n<s.count; n++){
+        schedule_step(&s, n, &idx, &ping);
+        if( ping.ant.phaseA != cfg.ant.phaseA.start + listA[n % 3] * cfg.ant.phaseA.step ) bad++;
+        if( ping.ant.phaseB != cfg.ant.phaseB.start ) bad++;
+        if( ping.power != cfg.power[0] || ping.channel != PH_CHANNEL_HOME ) bad++;
+        if( schedule_dwell(&s, n) != 10 + 5 * (n / 3) ) bad++;
+    }
+    CHECK(bad == 0, "TLV dimensions: %d wrong values", bad);
+
+    // A position past the driver dimension
+    spec.list[0] = 4;
+    CHECK(!schedule_check(&cfg, &spec), "A list value 4 of 4 accepted");
+}
+
+// -------------------------------------------------------------------------
+// Element dimensions: element 1 swept over the state of the A position,
+// element 0 kept from the driver. ant_linear.c has 2 elements of 8 bits.
+// -------------------------------------------------------------------------
+static void check_element_dims(const test_config_t *base)
+{
+    const uint8_t rec[] = {
+        TLV_DIM_RANGE, 7, SWEEP_DIM_ANT_A, TLV_U16(0), TLV_U16(1), TLV_U16(4),
+        TLV_DIM_LIST, 7, SWEEP_DIM_ELEMENT + 1, TLV_U16(200), TLV_U16(0), TLV_U16(255),
+    };
+    const uint16_t listEl[] = { 200, 0, 255 };
+    test_config_t cfg;
+    sweep_spec_t spec;
+    schedule_t s;
+    test_loop_t idx;
+    phaser_ping_t ping;
+    uint32_t n;
+    int bad = 0;
+
+    memcpy(&cfg, base, sizeof(cfg));
+    CHECK(tlv_parse(rec, sizeof(rec), &cfg, &spec), "element parse");
+    CHECK(schedule_check(&cfg, &spec), "element spec check");
+
+    schedule_init(&s, &cfg, &spec);
+    CHECK(s.count == 12, "element count %lu", (unsigned long)s.count);
+    for(n=0; n<s.count; n++){
+        schedule_step(&s, n, &idx, &ping);
+        if( ping.ant.format != ANT_FORMAT_2x8 ) bad++;
+        if( ANT_EL_GET(&ping.ant, 0, 8) != cfg.ant.phaseA.start + (n % 4) * cfg.ant.phaseA.step ) bad++;
+        if( ANT_EL_GET(&ping.ant, 1, 8) != listEl[n / 4] ) bad++;
+    }
+    CHECK(bad == 0, "element dimensions: %d wrong states", bad);
+
+    // Past the element width, past the element count, an element twice
+    spec.list[0] = 256;
+    CHECK(!schedule_check(&cfg, &spec), "element value 256 of 8 bits accepted");
+    spec.list[0] = 200;
+    spec.dim[1].kind = SWEEP_DIM_ELEMENT + 2;
+    CHECK(!schedule_check(&cfg, &spec), "element 2 of 2 accepted");
+    spec.dim[0].kind = SWEEP_DIM_ELEMENT + 1;
+    spec.dim[1].kind = SWEEP_DIM_ELEMENT + 1;
+    CHECK(!schedule_check(&cfg, &spec), "element 1 twice accepted");
+}
+
+// -------------------------------------------------------------------------
+// Chunks in any order, a lost one dropped after the timeout
+// -------------------------------------------------------------------------
+static void check_tlv_rx()
+{
+    static tlv_rx_t rx;
+    phaser_tlv_chunk_t c;
+    uint16_t len;
+
+    memset(&rx, 0, sizeof(rx));
+    memset(&c, 0, sizeof(c));
+    c.xfer = 1;
+    c.count = 3;
+
+    c.idx = 2; c.len = 10; c.data[0] = 0xc2;
+    CHECK(tlv_rx_chunk(&rx, &c, 100) == 0, "done after 1 of 3");
+    c.idx = 0; c.len = PH_TLV_CHUNK; c.data[0] = 0xc0;
+    CHECK(tlv_rx_chunk(&rx, &c, 105) == 0, "done after 2 of 3");
+    CHECK(!tlv_rx_expired(&rx, 105 + TLV_RX_TIMEOUT_MS - 1), "expired early");
+    c.idx = 1; c.data[0] = 0xc1;
+    len = tlv_rx_chunk(&rx, &c, 110);
+    CHECK(len == 2 * PH_TLV_CHUNK + 10, "len %d", len);
+    CHECK(rx.buf[0] == 0xc0 && rx.buf[PH_TLV_CHUNK] == 0xc1 && rx.buf[2 * PH_TLV_CHUNK] == 0xc2,
+        "chunk order");
+    CHECK(!tlv_rx_expired(&rx, 10000), "complete transfer expired");
+
+    // Chunk 1 lost
+    c.xfer = 2;
+    c.idx = 0;
+    tlv_rx_chunk(&rx, &c, 1000);
+    c.idx = 2; c.len = 10;
+    tlv_rx_chunk(&rx, &c, 1005);
+    CHECK(tlv_rx_expired(&rx, 1005 + TLV_RX_TIMEOUT_MS), "not expired");
+    CHECK(!tlv_rx_expired(&rx, 5000), "expired twice");
+    // The late chunk does not complete the dropped transfer
+    c.idx = 1; c.len = PH_TLV_CHUNK;
+    CHECK(tlv_rx_chunk(&rx, &c, 5000) == 0, "dropped transfer completed");
+
+    // Short chunk before the last one
+    c.xfer = 3;
+    c.idx = 0; c.len = 10;
+    CHECK(tlv_rx_chunk(&rx, &c, 6000) == 0 && rx.got == 0, "short first chunk taken");
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+int main()
+{
+    test_config_t cfg;
+
+    config_make(&cfg);
+    check_old_order(&cfg);
+    // Gray order for A (4 values), B (5) stays linear
+    cfg.ant_order = SWEEP_ORDER_GRAY;
+    check_old_order(&cfg);
+    cfg.ant_order = SWEEP_ORDER_LINEAR;
+    check_dim_order(&cfg);
+    check_tlv_dims(&cfg);
+    check_element_dims(&cfg);
+    check_tlv_rx();
+
+    return TEST_RESULT("schedule");
+}
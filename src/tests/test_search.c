@@ -0,0 +1,91 @@
+// --------------------------------------------
+// Beam search: convergence to the peak of a synthetic RSSI surface, for
+// every peak position, and the points not measured.
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "search.h"
+
+#include "test.h"
+
+
+// -------------------------------------------------------------------------
+// Unimodal surface, the peak at pA, pB: RSSI drops 3 dB per A position
+// and 2 dB per B position
+// -------------------------------------------------------------------------
+static int16_t surface(uint16_t kA, uint16_t kB, uint16_t pA, uint16_t pB)
+{
+    int16_t dA = (kA > pA) ? kA - pA : pA - kA;
+    int16_t dB = (kB > pB) ? kB - pB : pB - kB;
+    return -10 - 3 * dA - 2 * dB;
+}
+
+// -------------------------------------------------------------------------
+// Search until done; invalid: the point not measured, or none
+// -------------------------------------------------------------------------
+static void search_run(search_t *s, uint16_t countA, uint16_t countB, uint8_t coarse,
+    uint16_t pA, uint16_t pB, const uint16_t *invalid)
+{
+    uint16_t kA, kB;
+    bool valid;
+
+    search_start(s, countA, countB, coarse, &kA, &kB);
+    do{
+        valid = !invalid || kA != invalid[0] || kB != invalid[1];
+    } while( search_next(s, surface(kA, kB, pA, pB), valid, &kA, &kB) );
+}
+
+// -------------------------------------------------------------------------
+// The peak found at every position, in fewer steps than the full sweep
+// -------------------------------------------------------------------------
+static void check_converge(uint16_t countA, uint16_t countB, uint8_t coarse)
+{
+    search_t s;
+    uint16_t pA, pB, maxSteps = 0;
+    int bad = 0;
+
+    for(pA=0; pA<countA; pA++){
+        for(pB=0; pB<countB; pB++){
+            search_run(&s, countA, countB, coarse, pA, pB, NULL);
+            if( s.bestA != pA || s.bestB != pB || s.bestRssi != -10 ) bad++;
+            if( s.steps > maxSteps ) maxSteps = s.steps;
+        }
+    }
+    CHECK(bad == 0, "%ux%u coarse %u: %d peaks missed", countA, countB, coarse, bad);
+    CHECK(maxSteps < countA * countB, "%ux%u coarse %u: %u steps",
+        countA, countB, coarse, maxSteps);
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+int main()
+{
+    search_t s;
+    const uint16_t peak[] = { 10, 5 };
+    uint16_t kA, kB;
+
+    check_converge(32, 16, 4);
+    // The last grid point 4 positions from the end, stride 5
+    check_converge(20, 7, 4);
+    check_converge(16, 16, 2);
+
+    // One dimension not swept
+    check_converge(8, 1, 4);
+    search_run(&s, 0, 8, 4, 0, 6, NULL);
+    CHECK(s.bestA == 0 && s.bestB == 6, "A not swept: best %u,%u", s.bestA, s.bestB);
+
+    // The peak not measured: the best is a valid point next to it
+    search_run(&s, 32, 16, 4, peak[0], peak[1], peak);
+    CHECK(s.flBest && (s.bestA != peak[0] || s.bestB != peak[1]),
+        "invalid peak taken: %u,%u", s.bestA, s.bestB);
+    CHECK(s.bestRssi == -12, "invalid peak: best RSSI %d", s.bestRssi);
+
+    // Nothing measured: no best point, the grid and one refine level
+    search_start(&s, 8, 8, 2, &kA, &kB);
+    while( search_next(&s, 0, false, &kA, &kB) );
+    CHECK(!s.flBest, "best point without a measurement");
+    CHECK(s.steps == 4 + 4, "nothing measured: %u steps", s.steps);
+
+    return TEST_RESULT("search");
+}
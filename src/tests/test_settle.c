@@ -0,0 +1,96 @@
+// --------------------------------------------
+// Settle time calibration: the stop at the first failing candidate delay,
+// both states needed to pass, the tolerance, and no reference.
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "settle.h"
+
+#include "test.h"
+
+
+#define NO_FAIL 0xffff
+
+// RSSI of the two extreme states when settled, 1/4 dB
+static const int16_t stateRssi[2] = { -120, -88 };
+
+// -------------------------------------------------------------------------
+// Antenna model: off by err until settleUs[end] after the switch.
+// fail: one delay that also fails, whatever the model, or NO_FAIL.
+// Returns the measurements; the delays measured are in seen[].
+// -------------------------------------------------------------------------
+static uint8_t settle_run(settle_t *s, uint8_t tol, const uint16_t settleUs[2],
+    int16_t err, uint16_t fail, uint16_t *seen)
+{
+    uint16_t delayUs;
+    uint8_t end, n = 0;
+    int16_t rssi;
+
+    settle_start(s, tol, &delayUs, &end);
+    do{
+        rssi = stateRssi[end];
+        if( delayUs < settleUs[end] || delayUs == fail ) rssi += err;
+        if( seen ) seen[n] = delayUs;
+        n++;
+    } while( settle_next(s, rssi, true, &delayUs, &end) );
+    return n;
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+int main()
+{
+    settle_t s;
+    uint16_t seen[32], delayUs;
+    uint8_t n, end, i;
+    bool fl100;
+    const uint16_t t300[2] = { 300, 300 };
+    const uint16_t t0[2] = { 0, 0 };
+    const uint16_t tEnd1[2] = { 0, 1500 };
+
+    // Settled at 300 us: 500 passes, 200 fails on the first state
+    n = settle_run(&s, 4, t300, 20, NO_FAIL, seen);
+    CHECK(s.bestUs == 500, "300 us: settle %u", s.bestUs);
+    CHECK(n == 2 + 3*2 + 1, "300 us: %u measurements", n);
+    CHECK(seen[n - 1] == 200, "300 us: last delay %u", seen[n - 1]);
+
+    // 100 us would pass again: never measured after 200 failed
+    n = settle_run(&s, 4, t0, 20, 200, seen);
+    fl100 = false;
+    for(i=0; i<n; i++) if( seen[i] == 100 ) fl100 = true;
+    CHECK(s.bestUs == 500 && !fl100, "stop at 200: settle %u, 100 us %s",
+        s.bestUs, fl100 ? "measured" : "skipped");
+
+    // Only the last state is slow: both must pass
+    n = settle_run(&s, 4, tEnd1, 20, NO_FAIL, seen);
+    CHECK(s.bestUs == 2000, "last state slow: settle %u", s.bestUs);
+    CHECK(n == 2 + 2 + 2, "last state slow: %u measurements", n);
+
+    // Settled at once: every candidate passes
+    n = settle_run(&s, 4, t0, 20, NO_FAIL, NULL);
+    CHECK(s.bestUs == 0 && n == 2 * 9, "settled at once: settle %u, %u measurements",
+        s.bestUs, n);
+
+    // Off by the tolerance passes, one more fails
+    settle_run(&s, 4, t300, 4, NO_FAIL, NULL);
+    CHECK(s.bestUs == 0, "within the tolerance: settle %u", s.bestUs);
+    settle_run(&s, 4, t300, -5, NO_FAIL, NULL);
+    CHECK(s.bestUs == 500, "past the tolerance: settle %u", s.bestUs);
+
+    // No reference: no settle time
+    settle_start(&s, 4, &delayUs, &end);
+    CHECK(!settle_next(&s, 0, false, &delayUs, &end), "went on without data");
+    CHECK(s.bestUs == SETTLE_NONE, "no reference: settle %u", s.bestUs);
+
+    // Candidate not measured: the last delay passed is kept
+    settle_start(&s, 4, &delayUs, &end);
+    settle_next(&s, stateRssi[0], true, &delayUs, &end);
+    settle_next(&s, stateRssi[1], true, &delayUs, &end);
+    settle_next(&s, stateRssi[0], true, &delayUs, &end);
+    settle_next(&s, stateRssi[1], true, &delayUs, &end);
+    CHECK(!settle_next(&s, 0, false, &delayUs, &end) && s.bestUs == 2000,
+        "candidate not measured: settle %u", s.bestUs);
+
+    return TEST_RESULT("settle");
+}
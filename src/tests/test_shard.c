@@ -0,0 +1,143 @@
+// --------------------------------------------
+// Shard mapping: the contiguous shards tile the campaign for every count,
+// without the 64-bit product, and the global index maps back to the
+// entry, angle number and step of the sequential run.
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "schedule.h"
+#include "shard.h"
+
+#include "test.h"
+
+
+// -------------------------------------------------------------------------
+// Entry: powers, A x B states, channels and angles
+// -------------------------------------------------------------------------
+static void config_make(test_config_t *cfg, uint8_t powers, uint16_t countA,
+    uint16_t countB, uint16_t channels, uint16_t angles)
+{
+    uint8_t i;
+
+    memset(cfg, 0, sizeof(test_config_t));
+    for(i=0; i<powers; i++) cfg->power[i] = 31 - i;
+    cfg->ant.phaseA.step = 1;
+    cfg->ant.phaseA.count = countA;
+    cfg->ant.phaseB.step = 1;
+    cfg->ant.phaseB.count = countB;
+    cfg->channel.start = PH_CHANNEL_MIN;
+    cfg->channel.step = 1;
+    cfg->channel.count = channels;
+    cfg->angle_count = angles;
+    cfg->sweep_mode = SWEEP_MODE_FULL;
+}
+
+// -------------------------------------------------------------------------
+// The contiguous shards of each count follow each other from 0 to total
+// and are total * idx / count.
+// -------------------------------------------------------------------------
+static void check_contiguous(const test_config_t *set, size_t size)
+{
+    shard_t sh;
+    uint32_t total = shard_total(set, size), prevEnd;
+    unsigned count, idx;
+    int bad = 0;
+
+    for(count=1; count<=255; count++){
+        prevEnd = 0;
+        for(idx=0; idx<count; idx++){
+            if( !shard_init(&sh, set, size, idx, count, SHARD_MODE_RANGE) ){
+                // Empty shard: more shards than experiments
+                if( (uint64_t)total * (idx + 1) / count != prevEnd ) bad++;
+                continue;
+            }
+            if( sh.cur != prevEnd ) bad++;
+            if( sh.cur != (uint64_t)total * idx / count ) bad++;
+            if( sh.end != (uint64_t)total * (idx + 1) / count ) bad++;
+            prevEnd = sh.end;
+        }
+        if( prevEnd != total ) bad++;
+    }
+    CHECK(bad == 0, "total %lu: %d bad bounds", (unsigned long)total, bad);
+}
+
+// -------------------------------------------------------------------------
+// Every index is in one stride shard
+// -------------------------------------------------------------------------
+static void check_stride(const test_config_t *set, size_t size, uint8_t count)
+{
+    static uint8_t hits[4096];
+    shard_t sh;
+    uint32_t total = shard_total(set, size), g;
+    uint8_t idx;
+    int bad = 0;
+
+    memset(hits, 0, sizeof(hits));
+    for(idx=0; idx<count; idx++){
+        if( !shard_init(&sh, set, size, idx, count, SHARD_MODE_STRIDE) ) continue;
+        do {
+            hits[sh.cur]++;
+        } while( shard_next(&sh) );
+    }
+    for(g=0; g<total; g++) if( hits[g] != 1 ) bad++;
+    CHECK(bad == 0, "stride %d: %d indexes not in one shard", count, bad);
+}
+
+// -------------------------------------------------------------------------
+// The global index counts the entries, then the angles, then the steps
+// -------------------------------------------------------------------------
+static void check_locate(const test_config_t *set, size_t size)
+{
+    schedule_t s;
+    uint32_t g = 0, step, stepOut;
+    uint16_t angleNum, angles, angleOut;
+    uint8_t entry, entryOut;
+    int bad = 0;
+
+    for(entry=0; entry<size; entry++){
+        schedule_init(&s, &set[entry], NULL);
+        angles = set[entry].angle_count ? set[entry].angle_count : 1;
+        for(angleNum=0; angleNum<angles; angleNum++){
+            for(step=0; step<s.count; step++, g++){
+                shard_locate(set, size, g, &entryOut, &angleOut, &stepOut);
+                if( entryOut != entry || angleOut != angleNum || stepOut != step ) bad++;
+            }
+        }
+    }
+    CHECK(g == shard_total(set, size), "total %lu, counted %lu",
+        (unsigned long)shard_total(set, size), (unsigned long)g);
+    CHECK(bad == 0, "%d indexes located wrong", bad);
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+int main()
+{
+    test_config_t small[3];
+    test_config_t big[2];
+    shard_t sh;
+
+    config_make(&small[0], 2, 4, 3, 0, 5);      // 24 steps, 5 angles
+    config_make(&small[1], 1, 8, 0, 2, 0);      // No angle sweep
+    config_make(&small[2], 3, 2, 2, 0, 7);
+    check_contiguous(small, 3);
+    check_stride(small, 3, 1);
+    check_stride(small, 3, 3);
+    check_stride(small, 3, 7);
+    check_locate(small, 3);
+
+    // total * count beyond 32 bits
+    config_make(&big[0], 8, 255, 255, 16, 100);
+    config_make(&big[1], 1, 3, 1, 0, 1);
+    CHECK(shard_total(big, 2) > 0xffffffffu / 255, "total %lu",
+        (unsigned long)shard_total(big, 2));
+    check_contiguous(big, 2);
+
+    // Shards need the full sweep mode
+    small[1].sweep_mode = SWEEP_MODE_SEARCH;
+    CHECK(!shard_init(&sh, small, 3, 0, 2, SHARD_MODE_RANGE), "search mode sharded");
+    CHECK(!shard_init(&sh, big, 2, 2, 2, SHARD_MODE_RANGE), "idx >= count");
+
+    return TEST_RESULT("shard");
+}
@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+# --------------------------------------------
+# Host test of tools/trace_hist.py: parsing of the monitor log in
+# trace_sample.log, the phase durations and the report.
+# --------------------------------------------
+
+import io
+import os
+import sys
+import unittest
+from contextlib import redirect_stdout
+
+sys.dont_write_bytecode = True     # No __pycache__ in tools/
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(HERE, '..', 'tools'))
+
+import trace_hist   # noqa: E402
+
+SAMPLE = os.path.join(HERE, 'trace_sample.log')
+HEADER = os.path.join(HERE, '..', 'phaser_msg.h')
+
+TRACE_DUMP, TRACE_STEP, TRACE_DRAIN, TRACE_SEND, TRACE_TX_BUSY = 1, 2, 3, 11, 12
+
+
+def us(ticks, hz):
+    return ticks * 1000000.0 / hz
+
+
+class TraceHistTest(unittest.TestCase):
+
+    def setUp(self):
+        with open(SAMPLE) as f:
+            self.lines = f.readlines()
+        self.dumps = {node: (entries, hz) for node, entries, hz in trace_hist.read_dumps(self.lines)}
+
+    def test_phase_names(self):
+        names = trace_hist.phase_names(HEADER)
+        self.assertEqual(names[TRACE_DUMP], 'dump')
+        self.assertEqual(names[TRACE_SEND], 'send')
+        self.assertEqual(names[TRACE_TX_BUSY], 'tx_busy')
+
+    def test_dumps(self):
+        self.assertEqual(sorted(self.dumps), [0, 1, 2])
+        entries, hz = self.dumps[0]
+        self.assertEqual(hz, 32768)
+        # Sorted by index, the garbled entry 4 dropped
+        self.assertEqual([e[0] for e in entries], [0, 1, 2, 3, 5, 6, 7])
+        self.assertEqual(self.dumps[1][1], 1000000)
+        # No TraceEnd: the default clock
+        self.assertEqual(self.dumps[2][1], trace_hist.DEFAULT_HZ)
+
+    def test_durations(self):
+        entries, hz = self.dumps[0]
+        d = list(trace_hist.durations(entries, hz))
+        want = [(TRACE_DRAIN, us(8, hz)),          # Across the counter wrap
+                (TRACE_SEND, us(33, hz)),
+                (TRACE_TX_BUSY, us(33, hz)),
+                # Entry 5 follows the lost one: no duration
+                (TRACE_TX_BUSY, us(33, hz)),
+                (TRACE_DUMP, us(7, hz))]
+        self.assertEqual(len(d), len(want))
+        for (phase, t), (wphase, wt) in zip(d, want):
+            self.assertEqual(phase, wphase)
+            self.assertAlmostEqual(t, wt)
+
+    def test_report(self):
+        out = io.StringIO()
+        sys.argv = ['trace_hist.py', '--header', HEADER, '--node', '1', SAMPLE]
+        with redirect_stdout(out):
+            self.assertEqual(trace_hist.main(), 0)
+        rows = {l.split()[0]: l for l in out.getvalue().splitlines() if ' n=' in l}
+        self.assertEqual(sorted(rows), ['send', 'tx_busy'])
+        self.assertIn('n=1 ', rows['send'])
+        self.assertIn('mean=500 ', rows['send'])
+        self.assertIn('50.0%', rows['send'])
+
+    def test_report_no_dump_phase(self):
+        out = io.StringIO()
+        sys.argv = ['trace_hist.py', '--header', HEADER, '--node', '0', SAMPLE]
+        with redirect_stdout(out):
+            self.assertEqual(trace_hist.main(), 0)
+        self.assertNotIn('dump ', out.getvalue())
+        self.assertIn('drain ', out.getvalue())
+
+    def test_no_entries(self):
+        out = io.StringIO()
+        sys.argv = ['trace_hist.py', '--header', HEADER, '--node', '9', SAMPLE]
+        with redirect_stdout(out):
+            self.assertEqual(trace_hist.main(), 1)
+
+
+if __name__ == '__main__':
+    unittest.main()
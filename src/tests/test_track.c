@@ -0,0 +1,134 @@
+// --------------------------------------------
+// Beam tracking: the climb to a static peak and the stop there, the
+// hysteresis against a probe that is not better enough, the points not
+// measured, and a moving peak followed.
+// --------------------------------------------
+
+#include "stdmansos.h"
+
+#include "track.h"
+
+#include "test.h"
+
+
+// -------------------------------------------------------------------------
+// Unimodal surface, the peak at pA, pB, in 1/4 dB: 3 dB per position
+// -------------------------------------------------------------------------
+static int16_t surface(uint16_t kA, uint16_t kB, uint16_t pA, uint16_t pB)
+{
+    int16_t dA = (kA > pA) ? kA - pA : pA - kA;
+    int16_t dB = (kB > pB) ? kB - pB : pB - kB;
+    return -160 - 12 * (dA + dB);
+}
+
+// -------------------------------------------------------------------------
+// Bursts on the surface; returns the moves
+// -------------------------------------------------------------------------
+static uint16_t track_run(track_t *t, uint16_t *kA, uint16_t *kB, uint16_t bursts,
+    uint16_t pA, uint16_t pB)
+{
+    uint16_t i, moves = 0;
+
+    for(i=0; i<bursts; i++){
+        if( track_next(t, surface(*kA, *kB, pA, pB), true, kA, kB) ) moves++;
+    }
+    return moves;
+}
+
+// -------------------------------------------------------------------------
+// From a corner to the peak, then no more moves
+// -------------------------------------------------------------------------
+static void check_climb()
+{
+    track_t t;
+    uint16_t kA = 0, kB = 0, moves;
+
+    track_start(&t, 16, 8, 1, 4, &kA, &kB);
+    moves = track_run(&t, &kA, &kB, 200, 11, 5);
+    CHECK(t.curA == 11 && t.curB == 5, "climb: at %u,%u", t.curA, t.curB);
+    CHECK(moves == 11 + 5 && t.moves == moves, "climb: %u moves", moves);
+
+    moves = track_run(&t, &kA, &kB, 100, 11, 5);
+    CHECK(moves == 0, "at the peak: %u moves", moves);
+}
+
+// -------------------------------------------------------------------------
+// A probe must beat the current state by more than the hysteresis
+// -------------------------------------------------------------------------
+static void check_hysteresis()
+{
+    track_t t;
+    uint16_t kA = 4, kB = 0, i, moves = 0;
+    int16_t rssi;
+
+    // Every probe exactly hyst better: no move
+    track_start(&t, 8, 1, 1, 6, &kA, &kB);
+    for(i=0; i<50; i++){
+        rssi = (kA == t.curA) ? -100 : -100 + 6;
+        if( track_next(&t, rssi, true, &kA, &kB) ) moves++;
+    }
+    CHECK(moves == 0 && t.curA == 4, "hyst: %u moves at the threshold", moves);
+
+    // One more quarter dB: the first probe taken, -A
+    kA = 4;
+    track_start(&t, 8, 1, 1, 6, &kA, &kB);
+    track_next(&t, -100, true, &kA, &kB);
+    CHECK(kA == 3, "hyst: probe %u", kA);
+    CHECK(track_next(&t, -100 + 7, true, &kA, &kB), "hyst: better probe not taken");
+    CHECK(t.curA == 3 && t.curRssi == -93, "hyst: current %u rssi %d", t.curA, t.curRssi);
+    CHECK(kA == 3, "hyst: the new current state measured next, %u", kA);
+}
+
+// -------------------------------------------------------------------------
+// Not measured: no move to the probe, no probe before the current state
+// -------------------------------------------------------------------------
+static void check_invalid()
+{
+    track_t t;
+    uint16_t kA = 2, kB = 2;
+
+    track_start(&t, 8, 8, 2, 0, &kA, &kB);
+    track_next(&t, 0, false, &kA, &kB);
+    CHECK(kA == 2 && kB == 2 && !t.flProbe, "probe before the current state");
+
+    track_next(&t, -100, true, &kA, &kB);
+    CHECK(t.flProbe && kA == 0 && kB == 2, "stride 2 probe %u,%u", kA, kB);
+    CHECK(!track_next(&t, 100, false, &kA, &kB), "moved to a probe not measured");
+    CHECK(kA == 2 && kB == 2, "current state after the probe: %u,%u", kA, kB);
+
+    // Single state: nothing to probe
+    kA = kB = 0;
+    track_start(&t, 0, 0, 1, 0, &kA, &kB);
+    track_next(&t, -100, true, &kA, &kB);
+    CHECK(!t.flProbe && kA == 0 && kB == 0, "probe of a single state");
+}
+
+// -------------------------------------------------------------------------
+// The peak moves one A position every 40 bursts: followed within one
+// -------------------------------------------------------------------------
+static void check_follow()
+{
+    track_t t;
+    uint16_t kA = 2, kB = 3, p, far = 0;
+
+    track_start(&t, 16, 8, 1, 4, &kA, &kB);
+    track_run(&t, &kA, &kB, 40, 2, 3);
+    for(p=3; p<14; p++){
+        track_run(&t, &kA, &kB, 40, p, 3);
+        if( t.curA + 1 < p || t.curA > p || t.curB != 3 ) far++;
+    }
+    CHECK(far == 0, "follow: %u times off the peak", far);
+    CHECK(t.curA == 13, "follow: at %u", t.curA);
+}
+
+// -------------------------------------------------------------------------
+// -------------------------------------------------------------------------
+int main()
+{
+    check_climb();
+    check_hysteresis();
+    check_invalid();
+    check_follow();
+
+    return TEST_RESULT("track");
+}
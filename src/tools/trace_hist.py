@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+# --------------------------------------------
+# Per-phase latency histograms from the phaser timing trace.
+#
+# Reads the monitor serial log with the "Trace:" and "TraceEnd:" lines
+# (serial command "y" on the monitor, TRACE_PHASES in app_phaser) and
+# prints, for each phase of the test loop, the latency statistics, the
+# share of the loop time and a log2 histogram. Phase names are taken
+# from the TRACE_* enum in ../phaser_msg.h.
+#
+# Usage: trace_hist.py [log ...]      (stdin without arguments)
+# --------------------------------------------
+
+import argparse
+import os
+import re
+import sys
+
+DEFAULT_HZ = 32768      # TRACE_TICK_HZ of the default trace clock
+BAR_WIDTH = 40
+
+
+def phase_names(header):
+    names = {}
+    with open(header) as f:
+        for m in re.finditer(r'^\s*TRACE_(\w+)\s*=\s*(\d+)', f.read(), re.M):
+            names[int(m.group(2))] = m.group(1).lower()
+    return names
+
+
+def read_dumps(lines):
+    """Yield (node, entries, hz) for each dump; entries are (idx, ticks, phase, arg)."""
+    cur = {}
+    for line in lines:
+        f = line.strip().split('\t')
+        if f[0] == 'Trace:' and len(f) == 6:
+            node, idx, ticks, phase, arg = map(int, f[1:])
+            cur.setdefault(node, []).append((idx, ticks, phase, arg))
+        elif f[0] == 'TraceEnd:' and len(f) == 5:
+            node, hz = int(f[1]), int(f[4])
+            yield node, sorted(cur.pop(node, [])), hz or DEFAULT_HZ
+    # Dumps without the end line
+    for node, entries in cur.items():
+        yield node, sorted(entries), DEFAULT_HZ
+
+
+def durations(entries, hz):
+    """Phase durations in us: the ticks since the previous entry."""
+    prev = None
+    for idx, ticks, phase, arg in entries:
+        # A lost chunk leaves a gap, the duration across it is unknown
+        if prev is not None and idx == prev[0] + 1:
+            dt = (ticks - prev[1]) & 0xffff
+            yield phase, dt * 1000000.0 / hz
+        prev = (idx, ticks)
+
+
+def percentile(v, p):
+    return v[min(len(v) - 1, int(p * len(v)))]
+
+
+def print_phase(name, v, total):
+    v.sort()
+    s = sum(v)
+    print('%-10s n=%-6d mean=%-9.0f min=%-7.0f p50=%-7.0f p90=%-7.0f p99=%-7.0f max=%-7.0f %5.1f%%' % (
+        name, len(v), s / len(v), v[0], percentile(v, 0.5), percentile(v, 0.9),
+        percentile(v, 0.99), v[-1], 100.0 * s / total if total else 0))
+
+    # log2 buckets, us
+    buckets = {}
+    for x in v:
+        b = int(x).bit_length()
+        buckets[b] = buckets.get(b, 0) + 1
+    top = max(buckets.values())
+    for b in range(min(buckets), max(buckets) + 1):
+        n = buckets.get(b, 0)
+        lo = (1 << (b - 1)) if b else 0
+        print('    %8d us | %-*s %d' % (lo, BAR_WIDTH, '#' * ((n * BAR_WIDTH + top - 1) // top), n))
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Per-phase latency histograms from the phaser timing trace')
+    ap.add_argument('log', nargs='*', help='monitor serial log, stdin if none')
+    ap.add_argument('--header', default=os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'phaser_msg.h'),
+                    help='phaser_msg.h with the TRACE_* phases')
+    ap.add_argument('--node', type=int, help='only this phaser node')
+    args = ap.parse_args()
+
+    names = phase_names(args.header)
+    lines = []
+    for path in args.log:
+        with open(path, errors='replace') as f:
+            lines.extend(f)
+    if not args.log:
+        lines = sys.stdin.readlines()
+
+    per_phase = {}
+    for node, entries, hz in read_dumps(lines):
+        if args.node is not None and node != args.node:
+            continue
+        for phase, us in durations(entries, hz):
+            per_phase.setdefault(phase, []).append(us)
+
+    if not per_phase:
+        print('No trace entries')
+        return 1
+
+    # The dump itself is not loop time
+    per_phase.pop(next((k for k, n in names.items() if n == 'dump'), None), None)
+    total = sum(sum(v) for v in per_phase.values())
+    print('Phase latency, us. The share is of the traced loop time.')
+    for phase in sorted(per_phase, key=lambda k: -sum(per_phase[k])):
+        print_phase(names.get(phase, str(phase)), per_phase[phase], total)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())